@@ -0,0 +1,396 @@
+#include "AnswerMatcher.h"
+#include "DiceMachine.h"
+#include "DictionaryImage.h"
+#include "DictionaryParser.h"
+#include "DictionaryStore.h"
+#include "KatakanaFilter.h"
+#include "NihongoNoTango.h"
+#include "Record.h"
+#include "SuffixIndex.h"
+#include "TermWriter.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <codecvt>
+#include <locale>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::atomic<size_t> allocations(0);
+
+}
+
+void* operator new(const size_t size) {
+	++allocations;
+	void* result = malloc(size > 0 ? size : 1u);
+	if(result == nullptr) {
+		throw std::bad_alloc();
+	}
+	return result;
+}
+
+// Not inlined : GCC would see free() of a new-expression at the call sites.
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+	free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+	free(ptr);
+}
+
+/**
+ * Benchmarks of the hot paths : loading, tokenizing, transcoding, filtering and the quiz rounds.
+ * The loading and the rounds go through NihongoNoTango itself.
+ * The input is a generated dictionary, every case reports the best of REPEAT runs.
+ * Usage : nihongo_bench [megabytes] [kanji percent] [ascii percent]
+ * kanji percent - the records having the kanji, ascii percent - the records having an ASCII translation,
+ * the other ones are translated into Cyrillic.
+ */
+class Bench {
+
+	using Clock_t = std::chrono::steady_clock;
+
+	static constexpr unsigned REPEAT = 5;
+	// The rounds of a session, it draws that many records.
+	static constexpr size_t ROUNDS = 50;
+
+	const std::string _text;
+	const std::string _ascii;
+	std::vector<std::string_view> _lines;
+	size_t _ascii_lines;
+
+public:
+
+	Bench(const size_t bytes, const unsigned kanji_percent, const unsigned ascii_percent) :
+		_text(generate(bytes, kanji_percent, ascii_percent, false)), _ascii(generate(bytes, 0, 100, true)) {
+		for(size_t pos = 0; pos < _text.size();) {
+			const size_t end = _text.find('\n', pos);
+			_lines.push_back(std::string_view(_text).substr(pos, end - pos));
+			pos = end + 1u;
+		}
+		_ascii_lines = static_cast<size_t>(std::count(_ascii.begin(), _ascii.end(), '\n'));
+	}
+
+	void run() {
+		printf("Backend : %s, input : %zu bytes, %zu lines.\n", Utf8::backend(), _text.size(), _lines.size());
+		// The transcoding cases count a line of the input as an operation.
+		printf("%-32s %12s %12s %12s\n", "case", "ns/op", "MB/s", "allocs/op");
+
+		run_load();
+		run_transcoding();
+		run_quiz();
+	}
+
+private:
+
+	void run_load() {
+		report("Record::read", _lines.size(), _text.size(), [this]() {
+			Record rec;
+			bool result = true;
+			for(const auto& line : _lines) {
+				result = rec.read(line) && result;
+			}
+			return result;
+		});
+
+		DictionaryStore dic;
+		report("parse 1 thread", _lines.size(), _text.size(), [this, &dic]() {
+			dic.clear();
+			return DictionaryParser::parse(_text, dic, 1u) == 0;
+		});
+
+		report("parse all threads", _lines.size(), _text.size(), [this, &dic]() {
+			dic.clear();
+			return DictionaryParser::parse(_text, dic, 0u) == 0;
+		});
+
+		// The image is bound to its source file, so the text goes to a temporary file too.
+		char path[] = "/tmp/nihongo_bench_XXXXXX";
+		const int fd = mkstemp(path);
+		struct stat source;
+		const std::string image_path = DictionaryImage::path_for(path);
+		const bool has_image = (fd >= 0)
+			&& (write(fd, _text.data(), _text.size()) == ssize_t(_text.size()))
+			&& (fstat(fd, &source) == 0)
+			&& DictionaryImage::write(image_path.c_str(), dic, SuffixIndex(), source);
+		if(has_image) {
+			report("image read", 1u, 0, [&image_path, &source]() {
+				DictionaryStore mapped;
+				return DictionaryImage::read(image_path.c_str(), source, mapped);
+			});
+		} else {
+			printf("%-32s cannot be written\n", "image read");
+		}
+		if(fd >= 0) {
+			close(fd);
+			unlink(path);
+		}
+		remove(image_path.c_str());
+
+		run_app_load();
+	}
+
+	/**
+	 * NihongoNoTango::load() as a whole : from the text, from the image, and from two files
+	 * with a source filter and the duplicates across them.
+	 */
+	void run_app_load() const {
+		char dir[] = "/tmp/nihongo_bench_XXXXXX";
+		if(mkdtemp(dir) == nullptr) {
+			printf("%-32s cannot be written\n", "load");
+			return;
+		}
+		const std::string path = std::string(dir) + "/all.txt";
+		const std::string first = std::string(dir) + "/first.txt";
+		const std::string second = std::string(dir) + "/second.txt";
+		// The halves overlap by a quarter of the text, the overlap is dropped as the duplicates.
+		const size_t half = _text.find('\n', _text.size() / 2u) + 1u;
+		const size_t quarter = _text.find('\n', _text.size() / 4u) + 1u;
+		const std::string_view text(_text);
+		const size_t both_bytes = half + (text.size() - quarter);
+		const size_t both_lines = size_t(std::count(text.begin(), text.begin() + half, '\n') + std::count(text.begin() + quarter, text.end(), '\n'));
+		const bool is_written = write_file(path, text) && write_file(first, text.substr(0, half)) && write_file(second, text.substr(quarter));
+		if(is_written) {
+			report_load("load text", _lines.size(), text.size(), {"-d", path.c_str()});
+			NihongoNoTangoCli cli;
+			if(parse_cli(cli, {"compile", "-d", path.c_str()}) && silent([&cli]() { return NihongoNoTango(cli).compile() == EXIT_SUCCESS; })) {
+				report_load("load image", _lines.size(), text.size(), {"-d", path.c_str()});
+			} else {
+				printf("%-32s cannot be written\n", "load image");
+			}
+			report_load("load 2 files, filter, dedupe", both_lines, both_bytes, {"-d", first.c_str(), "-d", second.c_str(), "-S", "second.txt"});
+		} else {
+			printf("%-32s cannot be written\n", "load");
+		}
+		for(const std::string& file : {path, first, second}) {
+			remove(file.c_str());
+			remove(DictionaryImage::path_for(file).c_str());
+		}
+		rmdir(dir);
+	}
+
+	/**
+	 * @param lines, bytes - the text behind the sources, the image is measured against its text.
+	 */
+	static void report_load(const char* name, const size_t lines, const size_t bytes, std::initializer_list<const char*> sources) {
+		std::vector<const char*> args = {"learn", "-r", "1", "-k"};
+		args.insert(args.end(), sources.begin(), sources.end());
+		NihongoNoTangoCli cli;
+		if(not parse_cli(cli, args)) {
+			printf("%-32s cannot be configured\n", name);
+			return;
+		}
+		report(name, lines, bytes, [&cli]() {
+			return silent([&cli]() { return NihongoNoTango(cli).load() == EXIT_SUCCESS; });
+		});
+	}
+
+	static bool parse_cli(NihongoNoTangoCli& cli, std::vector<const char*> args) {
+		args.insert(args.begin(), "nihongo_bench");
+		std::vector<char*> argv;
+		for(const char* arg : args) {
+			argv.push_back(const_cast<char*>(arg));
+		}
+		argv.push_back(nullptr);
+		optind = 1;
+		return cli.parse_args(int(args.size()), argv.data());
+	}
+
+	static bool write_file(const std::string& path, const std::string_view& text) {
+		FILE* file = fopen(path.c_str(), "wb");
+		bool result = (file != nullptr);
+		if(result) {
+			result = (fwrite(text.data(), 1, text.size(), file) == text.size());
+			result = (fclose(file) == 0) && result;
+		}
+		return result;
+	}
+
+	/**
+	 * Runs @fn with the standard output going to /dev/null, the loading messages stay out of the report.
+	 */
+	template <typename F>
+	static bool silent(F&& fn) {
+		fflush(stdout);
+		const int saved = dup(STDOUT_FILENO);
+		const int null = open("/dev/null", O_WRONLY);
+		dup2(null, STDOUT_FILENO);
+		const bool result = fn();
+		fflush(stdout);
+		dup2(saved, STDOUT_FILENO);
+		close(null);
+		close(saved);
+		return result;
+	}
+
+	void run_transcoding() {
+		report("validate scalar", _lines.size(), _text.size(), [this]() {
+			return Utf8::validate_scalar(reinterpret_cast<const uint8_t*>(_text.data()), _text.size());
+		});
+
+		report("validate", _lines.size(), _text.size(), [this]() {
+			return Utf8::validate(_text);
+		});
+
+		report("validate ascii", _ascii_lines, _ascii.size(), [this]() {
+			return Utf8::validate(_ascii);
+		});
+
+		std::u32string u32;
+		report("decode", _lines.size(), _text.size(), [this, &u32]() {
+			return Utf8::decode(_text, u32);
+		});
+
+		report("decode ascii", _ascii_lines, _ascii.size(), [this, &u32]() {
+			return Utf8::decode(_ascii, u32);
+		});
+
+		report("decode wstring_convert", _lines.size(), _text.size(), [this, &u32]() {
+			std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> conv;
+			u32 = conv.from_bytes(_text);
+			return not u32.empty();
+		});
+
+		Utf8::decode(_text, u32);
+		std::string utf8;
+		report("encode", _lines.size(), _text.size(), [&u32, &utf8]() {
+			utf8.clear();
+			Utf8::encode(u32, utf8);
+			return not utf8.empty();
+		});
+
+		report("encode wstring_convert", _lines.size(), _text.size(), [&u32, &utf8]() {
+			std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> conv;
+			utf8 = conv.to_bytes(u32);
+			return not utf8.empty();
+		});
+
+		const KatakanaFilter filter;
+		report("katakana filter", _lines.size(), _text.size(), [&filter, &u32]() {
+			filter.apply(u32);
+			return not u32.empty();
+		});
+	}
+
+	void run_quiz() {
+		DictionaryStore dic;
+		DictionaryParser::parse(_text, dic, 1u);
+		DiceMachine dm(1u);
+		const size_t rounds = std::min(ROUNDS, dic.size());
+		report("shuffle", rounds, 0, [&dic, &dm, rounds]() {
+			return dm.sample(dic.begin(), dic.end(), rounds) == dic.begin() + rounds;
+		});
+
+		// The body of a test round, as in NihongoNoTango::run() : the question written out, the reference and the check.
+		NihongoNoTangoCli cli;
+		if(not parse_cli(cli, {"test", "-r", "1", "-d", "-", "-j", "-k", "-a", "translation"})) {
+			printf("%-32s cannot be configured\n", "round");
+			return;
+		}
+		const NihongoNoTango app(cli);
+		const int null = open("/dev/null", O_WRONLY);
+		TermWriter out(null);
+		const KatakanaFilter filter;
+		AnswerMatcher matcher(true, true, 1u);
+		std::u32string answer;
+		std::u32string reference;
+		report("round", dic.size(), dic.pool_size(), [&]() {
+			bool result = false;
+			for(size_t idx = 0; idx < dic.size(); ++idx) {
+				const Record rec = dic[idx];
+				app.build_question(rec, out);
+				out.flush();
+				Utf8::decode(app.build_reference(rec), reference);
+				filter.apply(reference);
+				answer = reference;
+				result = matcher.match(answer, reference) || result;
+			}
+			return result;
+		});
+		close(null);
+	}
+
+	/**
+	 * @param ops - the operations done by one call of @fn.
+	 * @param bytes - the input of one call of @fn, 0 if the throughput makes no sense.
+	 */
+	template <typename F>
+	static void report(const char* name, const size_t ops, const size_t bytes, F&& fn) {
+		double best = 0;
+		size_t best_allocs = 0;
+		bool ok = true;
+		for(unsigned i = 0; i < REPEAT; ++i) {
+			const size_t allocs_before = allocations;
+			const auto before = Clock_t::now();
+			ok = fn() && ok;
+			const std::chrono::duration<double> elapsed = Clock_t::now() - before;
+			if(i == 0 || elapsed.count() < best) {
+				best = elapsed.count();
+				best_allocs = allocations - allocs_before;
+			}
+		}
+		const size_t op_cnt = std::max<size_t>(ops, 1u);
+		printf("%-32s %12.2f", name, best * 1e9 / double(op_cnt));
+		if(bytes > 0) {
+			printf(" %12.1f", double(bytes) / best / 1e6);
+		} else {
+			printf(" %12s", "-");
+		}
+		printf(" %12.3f%s\n", double(best_allocs) / double(op_cnt), ok ? "" : " (failed)");
+	}
+
+	/**
+	 * Dictionary-like text : `kanji;kana;translation` lines, only the ASCII translations if @ascii_only.
+	 */
+	static std::string generate(const size_t bytes, const unsigned kanji_percent, const unsigned ascii_percent, const bool ascii_only) {
+		static const char* const KANJI[] = {"日", "本", "語", "水", "火", "単", "語"};
+		static const char* const KANA[] = {"に", "ほ", "ん", "ご", "み", "ず", "カ", "ナ"};
+		static const char* const WORDS[] = {"water", "fire", "word", "language", "cat", "Japan"};
+		static const char* const CYRILLIC[] = {"вода", "огонь", "слово", "язык", "кошка", "Япония"};
+		std::string result;
+		result.reserve(bytes + 64u);
+		unsigned seed = 1;
+		const auto next = [&seed](const unsigned range) {
+			seed = seed * 1103515245u + 12345u;
+			return (seed >> 16) % range;
+		};
+		while(result.size() < bytes) {
+			if(not ascii_only) {
+				if(next(100) < kanji_percent) {
+					for(unsigned i = 0, n = 1 + next(3); i < n; ++i) {
+						result.append(KANJI[next(7)]);
+					}
+				}
+				result.push_back(';');
+				for(unsigned i = 0, n = 2 + next(4); i < n; ++i) {
+					result.append(KANA[next(8)]);
+				}
+				result.push_back(';');
+			}
+			result.append(next(100) < ascii_percent ? WORDS[next(6)] : CYRILLIC[next(6)]);
+			result.push_back('\n');
+		}
+		return result;
+	}
+
+};
+
+int main(int argc, char** argv) {
+	const size_t megabytes = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 16u;
+	const auto kanji_percent = static_cast<unsigned>((argc > 2) ? strtoul(argv[2], nullptr, 10) : 70u);
+	const auto ascii_percent = static_cast<unsigned>((argc > 3) ? strtoul(argv[3], nullptr, 10) : 100u);
+	Bench bench(megabytes * 1024u * 1024u, kanji_percent, ascii_percent);
+	bench.run();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "CodePointMap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Compares an answer with the reference text of a record.
+ *
+ * The normalization folds katakana into hiragana, full-width and half-width forms
+ * into the regular ones, the dash look-alikes into the long vowel mark, ASCII into
+ * lower case and drops the whitespace, a kana followed by a (half-width) voicing mark
+ * is composed. All of it is a table lookup per code point.
+ *
+ * A translation may hold several ','-separated alternatives, any of them is accepted
+ * with up to @max_typos edits (Myers' bit-parallel edit distance), one edit per
+ * TYPO_SPAN characters of the alternative at most.
+ *
+ * The buffers are reused, a comparison does not allocate once they are warmed up.
+ */
+class AnswerMatcher {
+public:
+
+	using String_t = std::u32string;
+	using View_t = std::u32string_view;
+
+	static constexpr char32_t SEPARATOR = U',';
+	static constexpr size_t TYPO_SPAN = 4;
+
+private:
+
+	using Table_t = CodePointMap<6>;
+
+	static constexpr char32_t LONG_VOWEL = U'ー';
+	static constexpr char32_t VOICED_MARK = 0x3099;
+	static constexpr char32_t SEMI_VOICED_MARK = 0x309A;
+
+	static constexpr size_t WORD_BITS = 64;
+
+	const bool _normalize;
+	const bool _alternatives;
+	const unsigned _max_typos;
+
+	String_t _answer;
+	String_t _reference;
+
+	// The pattern of Myers' algorithm : the distinct code points and their position masks.
+	char32_t _peq_cp[WORD_BITS];
+	uint64_t _peq_mask[WORD_BITS];
+	size_t _peq_size;
+
+public:
+
+	/**
+	 * @param alternatives - the reference is a translation, its alternatives and typos are accepted.
+	 */
+	AnswerMatcher(const bool normalize, const bool alternatives, const unsigned max_typos) :
+		_normalize(normalize), _alternatives(alternatives), _max_typos(alternatives ? max_typos : 0u), _peq_size(0) {}
+
+	bool match(const View_t& answer, const View_t& reference) {
+		View_t ans = answer;
+		View_t ref = reference;
+		if(_normalize) {
+			normalize(answer, _answer);
+			normalize(reference, _reference);
+			ans = _answer;
+			ref = _reference;
+		}
+
+		if(not _alternatives) {
+			return ans == ref;
+		}
+
+		bool result = false;
+		size_t pos = 0;
+		while(not result) {
+			const size_t end = std::min(ref.find(SEPARATOR, pos), ref.size());
+			result = match_alternative(ans, ref.substr(pos, end - pos));
+			if(end == ref.size()) {
+				break;
+			}
+			pos = end + 1u;
+		}
+		return result;
+	}
+
+	/**
+	 * Writes the normalized @in into @out.
+	 */
+	static void normalize(const View_t& in, String_t& out) {
+		out.clear();
+		for(const char32_t ch : in) {
+			const char32_t cp = TABLE(ch);
+			if(cp == Table_t::DROP) {
+				continue;
+			}
+			if((cp == VOICED_MARK || cp == SEMI_VOICED_MARK) && (not out.empty())) {
+				const char32_t composed = (cp == VOICED_MARK) ? VOICED(out.back()) : SEMI_VOICED(out.back());
+				if(composed != out.back()) {
+					out.back() = composed;
+					continue;
+				}
+			}
+			out.push_back(cp);
+		}
+	}
+
+	/**
+	 * Levenshtein distance, Myers' algorithm for @pattern up to 64 characters.
+	 * @return The distance if it is not greater than @bound, @bound + 1 otherwise.
+	 */
+	unsigned distance(const View_t& pattern, const View_t& text, const unsigned bound) {
+		const size_t len_diff = (pattern.size() > text.size()) ? pattern.size() - text.size() : text.size() - pattern.size();
+		if(len_diff > bound) {
+			return bound + 1u;
+		}
+		if(pattern.empty() || text.empty()) {
+			return static_cast<unsigned>(len_diff);
+		}
+		if(pattern.size() > WORD_BITS) {
+			return (pattern == text) ? 0u : bound + 1u;
+		}
+
+		build_peq(pattern);
+		const uint64_t last = uint64_t(1) << (pattern.size() - 1u);
+		uint64_t pv = ~uint64_t(0);
+		uint64_t mv = 0;
+		size_t score = pattern.size();
+		for(const char32_t ch : text) {
+			const uint64_t eq = peq(ch);
+			const uint64_t xv = eq | mv;
+			const uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+			uint64_t ph = mv | ~(xh | pv);
+			uint64_t mh = pv & xh;
+			if(ph & last) {
+				++score;
+			} else if(mh & last) {
+				--score;
+			}
+			// The first row of the matrix grows by one per text character.
+			ph = (ph << 1u) | 1u;
+			mh <<= 1u;
+			pv = mh | ~(xv | ph);
+			mv = ph & xv;
+		}
+		return (score > bound) ? bound + 1u : static_cast<unsigned>(score);
+	}
+
+private:
+
+	bool match_alternative(const View_t& answer, View_t alternative) {
+		while((not alternative.empty()) && is_space(alternative.front())) {
+			alternative.remove_prefix(1);
+		}
+		while((not alternative.empty()) && is_space(alternative.back())) {
+			alternative.remove_suffix(1);
+		}
+		if(answer == alternative) {
+			return true;
+		}
+		const unsigned bound = std::min<unsigned>(_max_typos, static_cast<unsigned>(alternative.size() / TYPO_SPAN));
+		return bound > 0 && distance(alternative, answer, bound) <= bound;
+	}
+
+	void build_peq(const View_t& pattern) {
+		_peq_size = 0;
+		for(size_t idx = 0; idx < pattern.size(); ++idx) {
+			size_t slot = 0;
+			while(slot < _peq_size && _peq_cp[slot] != pattern[idx]) {
+				++slot;
+			}
+			if(slot == _peq_size) {
+				_peq_cp[_peq_size] = pattern[idx];
+				_peq_mask[_peq_size++] = 0;
+			}
+			_peq_mask[slot] |= uint64_t(1) << idx;
+		}
+	}
+
+	uint64_t peq(const char32_t ch) const {
+		for(size_t slot = 0; slot < _peq_size; ++slot) {
+			if(_peq_cp[slot] == ch) {
+				return _peq_mask[slot];
+			}
+		}
+		return 0;
+	}
+
+	static bool is_space(const char32_t ch) {
+		return ch == U' ' || ch == U'\t' || ch == 0x3000;
+	}
+
+	static constexpr Table_t build_table() {
+		Table_t table;
+		// ASCII
+		table.set_range(U'A', U'Z', U'a');
+		table.set(U' ', Table_t::DROP);
+		table.set(U'\t', Table_t::DROP);
+		// Dashes and minus signs typed instead of the long vowel mark.
+		for(char32_t cp = 0x2010; cp <= 0x2015; ++cp) {
+			table.set(cp, LONG_VOWEL);
+		}
+		table.set(0x2212, LONG_VOWEL);
+		// CJK symbols, hiragana and katakana.
+		table.set(0x3000, Table_t::DROP);
+		table.set_range(U'ァ', U'ヶ', U'ぁ');
+		table.set(U'ヽ', U'ゝ');
+		table.set(U'ヾ', U'ゞ');
+		table.set(0x309B, VOICED_MARK);
+		table.set(0x309C, SEMI_VOICED_MARK);
+		// Full-width ASCII.
+		table.set_range(0xFF01, 0xFF5E, U'!');
+		table.set_range(0xFF21, 0xFF3A, U'a');
+		// Half-width katakana.
+		constexpr char32_t HALF_WIDTH[] = {
+			U'。', U'「', U'」', U'、', U'・', U'を',
+			U'ぁ', U'ぃ', U'ぅ', U'ぇ', U'ぉ', U'ゃ', U'ゅ', U'ょ', U'っ', LONG_VOWEL,
+			U'あ', U'い', U'う', U'え', U'お', U'か', U'き', U'く', U'け', U'こ',
+			U'さ', U'し', U'す', U'せ', U'そ', U'た', U'ち', U'つ', U'て', U'と',
+			U'な', U'に', U'ぬ', U'ね', U'の', U'は', U'ひ', U'ふ', U'へ', U'ほ',
+			U'ま', U'み', U'む', U'め', U'も', U'や', U'ゆ', U'よ',
+			U'ら', U'り', U'る', U'れ', U'ろ', U'わ', U'ん', VOICED_MARK, SEMI_VOICED_MARK
+		};
+		for(size_t idx = 0; idx < sizeof(HALF_WIDTH) / sizeof(HALF_WIDTH[0]); ++idx) {
+			table.set(static_cast<char32_t>(0xFF61 + idx), HALF_WIDTH[idx]);
+		}
+		return table;
+	}
+
+	/**
+	 * Maps a hiragana to its voiced (@semi = false) or semi-voiced form.
+	 */
+	static constexpr Table_t build_voicing(const bool semi) {
+		Table_t table;
+		if(semi) {
+			for(char32_t cp = U'は'; cp <= U'ほ'; cp += 3) {
+				table.set(cp, cp + 2u);
+			}
+		} else {
+			for(char32_t cp = U'か'; cp <= U'ち'; cp += 2) {
+				table.set(cp, cp + 1u);
+			}
+			for(char32_t cp = U'つ'; cp <= U'と'; cp += 2) {
+				table.set(cp, cp + 1u);
+			}
+			for(char32_t cp = U'は'; cp <= U'ほ'; cp += 3) {
+				table.set(cp, cp + 1u);
+			}
+			table.set(U'う', U'ゔ');
+			table.set(U'ゝ', U'ゞ');
+		}
+		return table;
+	}
+
+	static const Table_t TABLE;
+	static const Table_t VOICED;
+	static const Table_t SEMI_VOICED;
+
+};
+
+inline constexpr AnswerMatcher::Table_t AnswerMatcher::TABLE = AnswerMatcher::build_table();
+inline constexpr AnswerMatcher::Table_t AnswerMatcher::VOICED = AnswerMatcher::build_voicing(false);
+inline constexpr AnswerMatcher::Table_t AnswerMatcher::SEMI_VOICED = AnswerMatcher::build_voicing(true);
@@ -3,40 +3,91 @@
 #include "FieldReader.h"
 #include "FieldWriter.h"
 
+#include <algorithm>
+#include <array>
+#include <bitset>
 #include <cassert>
-#include <set>
-#include <map>
+#include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <string_view>
+#include <utility>
 #include <getopt.h>
+#include <unistd.h>
 
 struct OptionBase {
 
+	/**
+	 * The origins of the user values, a later one takes precedence.
+	 */
+	enum Source : unsigned {
+		DEFAULT,
+		CONFIG,
+		ENVIRONMENT,
+		ARGUMENT
+	};
+
 	const bool has_default_value;
 	bool has_user_value;
 	const bool has_argument;
 	const char name;
+	// The name in the config file and the environment, nullptr if the option is not read from them.
+	const char* const key;
 	const unsigned print_priority;
 	std::string desc;
+	Source source;
 
-	OptionBase(bool _has_def_value, const bool _has_arg, const char _name, std::string _desc, const unsigned _print_priority) :
-		has_default_value(_has_def_value), has_user_value(false), has_argument(_has_arg), name(_name), print_priority(_print_priority), desc(std::move(_desc))
+	OptionBase(bool _has_def_value, const bool _has_arg, const char _name, const char* _key, std::string _desc, const unsigned _print_priority) :
+		has_default_value(_has_def_value), has_user_value(false), has_argument(_has_arg), name(_name), key(_key), print_priority(_print_priority), desc(std::move(_desc)), source(DEFAULT)
 	{}
 
 	virtual ~OptionBase() = default;
 
-	bool parse(const char* arg) {
+	/**
+	 * A value from a lower source than the current one is ignored, a value from a higher one
+	 * replaces the current one, the values from the same source accumulate in a repeatable option.
+	 */
+	bool parse(const char* arg, const Source src = ARGUMENT) {
+		if(src < source) {
+			return true;
+		}
+		if(src > source) {
+			reset_impl();
+			source = src;
+		}
 		has_user_value = parse_impl(arg);
 		return has_user_value;
 	}
 
+	/**
+	 * Turns a flag off, unless a higher source has turned it on.
+	 */
+	void unset(const Source src) {
+		if(src >= source) {
+			reset_impl();
+			has_user_value = false;
+			source = src;
+		}
+	}
+
 	bool presented() const {
 		return has_default_value || has_user_value;
 	}
 
 	virtual bool parse_impl(const char* arg) = 0;
+	virtual void reset_impl() = 0;
 	virtual void print(FILE* out) = 0;
 
+protected:
+
+	void print_name(FILE* out) const {
+		if(key) {
+			fprintf(out, "\t -%c, --%s : %s", name, key, desc.c_str());
+		} else {
+			fprintf(out, "\t -%c %s", name, desc.c_str());
+		}
+	}
+
 };
 
 template <typename T>
@@ -46,15 +97,25 @@ struct Option : public OptionBase {
 	T value_user;
 
 	Option(const char _name, std::string _desc, const unsigned _print_priority) :
-		Base_t(false, true, _name,  std::move(_desc), _print_priority), value_def(T()) {}
+		Base_t(false, true, _name, nullptr, std::move(_desc), _print_priority), value_def(T()) {}
 
 	Option(const char _name, std::string _desc, const unsigned _print_priority, T _def_value) :
-		Base_t(true, true, _name,  std::move(_desc), _print_priority), value_def(std::move(_def_value)) {}
+		Base_t(true, true, _name, nullptr, std::move(_desc), _print_priority), value_def(std::move(_def_value)) {}
+
+	Option(const char _name, const char* _key, std::string _desc, const unsigned _print_priority) :
+		Base_t(false, true, _name, _key, std::move(_desc), _print_priority), value_def(T()) {}
+
+	Option(const char _name, const char* _key, std::string _desc, const unsigned _print_priority, T _def_value) :
+		Base_t(true, true, _name, _key, std::move(_desc), _print_priority), value_def(std::move(_def_value)) {}
 
 	bool parse_impl(const char* arg) override {
 		return FieldReader::read(value_user, arg);
 	}
 
+	void reset_impl() override {
+		value_user = T();
+	}
+
 	operator const T&() const {
 		return value();
 	}
@@ -64,11 +125,11 @@ struct Option : public OptionBase {
 	}
 
 	void print(FILE* out) final {
-		fprintf(out, "\t -%c %s", name, desc.c_str());
+		print_name(out);
 		if(has_default_value) {
-			std::string buf;
-			FieldWriter::write(buf, value_def);
-			fprintf(out, " default='%s'", buf.c_str());
+			fputs(" default='", out);
+			FieldWriter::write(out, value_def);
+			fputc('\'', out);
 		}
 		fprintf(out, "\n");
 	}
@@ -78,38 +139,37 @@ struct Option : public OptionBase {
 struct OptionFlag : public OptionBase {
 	using Base_t = OptionBase;
 
-	OptionFlag(const char _name, std::string _desc, const unsigned _print_priority) : Base_t(false, false, _name,  std::move(_desc), _print_priority) {}
+	OptionFlag(const char _name, std::string _desc, const unsigned _print_priority) : Base_t(false, false, _name, nullptr, std::move(_desc), _print_priority) {}
+
+	OptionFlag(const char _name, const char* _key, std::string _desc, const unsigned _print_priority) : Base_t(false, false, _name, _key, std::move(_desc), _print_priority) {}
 
-	bool parse_impl(const char* arg) override { return true; }
-	void print(FILE* out) final { fprintf(out, "\t -%c %s\n", name, desc.c_str()); }
+	bool parse_impl(const char*) override { return true; }
+	void reset_impl() override {}
+	void print(FILE* out) final { print_name(out); fprintf(out, "\n"); }
 };
 
-struct OptionItem {
-	OptionBase* opt;
-	bool mandatory;
+/**
+ * The options are indexed by the name, which is an ASCII character.
+ */
+static constexpr size_t OPTION_NAMES = 128;
 
-	bool operator<(const OptionItem& rv) const {
-		return opt->print_priority < rv.opt->print_priority;
-	}
-};
+using OptionSet_t = std::bitset<OPTION_NAMES>;
 
 struct Method {
 
-	std::set<OptionItem> options;
-	std::string _desc;
+	std::array<OptionBase*, OPTION_NAMES> options = {};
+	OptionSet_t members;
+	OptionSet_t mandatory;
+	const char* _desc = "";
 
-	Method& desc(std::string desc) noexcept {
-		_desc = std::move(desc);
+	Method& desc(const char* desc) noexcept {
+		_desc = desc;
 		return *this;
 	}
 
 	template <typename T>
 	Method& mand(Option<T>& op) noexcept {
-		OptionItem value{&op, true};
-		if(not options.emplace(value).second) {
-			fprintf(stderr,"'%c' option is duplicated.\n", op.name);
-			assert(false);
-		}
+		add(op, true);
 		return *this;
 	}
 
@@ -121,11 +181,7 @@ struct Method {
 	}
 
 	Method& opt(OptionBase& op) noexcept {
-		OptionItem value{&op, false};
-		if(not options.emplace(value).second) {
-			fprintf(stderr,"'%c' option is duplicated.\n", op.name);
-			assert(false);
-		}
+		add(op, false);
 		return *this;
 	}
 
@@ -135,30 +191,116 @@ struct Method {
 		opt(args...);
 		return *this;
 	}
+
+	size_t size() const {
+		return members.count();
+	}
+
+private:
+
+	void add(OptionBase& op, const bool is_mandatory) noexcept {
+		const auto idx = static_cast<unsigned char>(op.name);
+		if(idx >= OPTION_NAMES || members.test(idx)) {
+			fprintf(stderr,"'%c' option is duplicated.\n", op.name);
+			assert(false);
+			return;
+		}
+		options[idx] = &op;
+		members.set(idx);
+		mandatory.set(idx, is_mandatory);
+	}
 };
 
 
 class AppCliBasic {
 
+	using Key_t = std::pair<std::string_view, OptionBase*>;
+
 protected:
 
-	std::map<char, OptionBase*> _opt_map;
-	std::string _opt_names;
+	std::array<OptionBase*, OPTION_NAMES> _opt_table = {};
+	// The options in the print order.
+	std::array<OptionBase*, OPTION_NAMES> _opt_order = {};
+	size_t _opt_count = 0;
+	// The getopt() option string : a name, ':' if it has an argument.
+	char _opt_names[OPTION_NAMES * 2u + 1u] = {};
+	// '-' and the option names.
+	char _opt_string[OPTION_NAMES + 2u] = {};
+	// The options having a key, sorted by the key.
+	std::array<Key_t, OPTION_NAMES> _opt_keys = {};
+	size_t _key_count = 0;
+	// The environment variables which cannot be parsed, by the option name.
+	std::array<const char*, OPTION_NAMES> _env_errors = {};
+	// The getopt_long() table : the keys are the long names, terminated by a zero entry.
+	struct option _long_opts[OPTION_NAMES + 1u] = {};
+	const char* _env_prefix = nullptr;
+	const Option<std::string>* _config = nullptr;
 
 	virtual bool post_validate() const = 0;
 	virtual void build_option_map() = 0;
 
+	/**
+	 * Parses the arguments left after the options, @argv has @argc of them.
+	 */
+	virtual bool parse_operands(int argc, char** argv) = 0;
+
+	/**
+	 * @return true if @opt matters to the selected method.
+	 */
+	virtual bool is_used(const OptionBase& opt) const = 0;
+
 public:
 
+	/**
+	 * Reads the options having a key also from the @env_prefix<KEY> environment variables
+	 * and from the key=value file named by @config, the key is upper-cased and '-' becomes '_'
+	 * in a variable name. The command line takes precedence over the environment, the environment
+	 * over the file.
+	 */
+	void sources(const char* env_prefix, const Option<std::string>& config) {
+		_env_prefix = env_prefix;
+		_config = &config;
+	}
+
 	void finalize() {
-		_opt_names.clear();
-		_opt_map.clear();
+		_opt_table.fill(nullptr);
 		build_option_map();
 
-		for(const auto& item : _opt_map) {
-			_opt_names.push_back(item.first);
-			if(item.second->has_argument) {
-				_opt_names.push_back(':');
+		size_t pos = 0;
+		_opt_count = 0;
+		_key_count = 0;
+		for(size_t idx = 0; idx < OPTION_NAMES; ++idx) {
+			OptionBase* opt = _opt_table[idx];
+			if(opt == nullptr) {
+				continue;
+			}
+			_opt_order[_opt_count++] = opt;
+			_opt_names[pos++] = static_cast<char>(idx);
+			if(opt->has_argument) {
+				_opt_names[pos++] = ':';
+			}
+			if(opt->key) {
+				_opt_keys[_key_count++] = Key_t(opt->key, opt);
+			}
+		}
+		_opt_names[pos] = '\0';
+		_opt_string[0] = '-';
+		for(size_t idx = 0; idx < _opt_count; ++idx) {
+			_opt_string[idx + 1u] = _opt_order[idx]->name;
+		}
+		_opt_string[_opt_count + 1u] = '\0';
+		std::sort(_opt_order.begin(), _opt_order.begin() + _opt_count,
+			[](const OptionBase* lv, const OptionBase* rv) { return lv->print_priority < rv->print_priority; });
+		std::sort(_opt_keys.begin(), _opt_keys.begin() + _key_count);
+		for(size_t idx = 0; idx < _key_count; ++idx) {
+			const OptionBase* opt = _opt_keys[idx].second;
+			_long_opts[idx] = {opt->key, opt->has_argument ? required_argument : no_argument, nullptr, opt->name};
+		}
+		_long_opts[_key_count] = {nullptr, 0, nullptr, 0};
+		for(size_t idx = 1; idx < _key_count; ++idx) {
+			if(_opt_keys[idx].first == _opt_keys[idx - 1u].first) {
+				fprintf(stderr,"Option key '%s' is duplicated.\n", _opt_keys[idx].second->key);
+				assert(false);
 			}
 		}
 	}
@@ -167,13 +309,13 @@ public:
 		bool result = true;
 		int opt;
 
-		while((opt = getopt(argc, argv, _opt_names.c_str())) != EOF) {
+		while((opt = getopt_long(argc, argv, _opt_names, _long_opts, nullptr)) != EOF) {
 			const char opt_char = static_cast<char>(opt);
-			const auto it = _opt_map.find(opt_char);
+			OptionBase* const option = find(opt_char);
 			bool opt_parse_reault = false;
 
-			if(it != _opt_map.end()) {
-				opt_parse_reault = it->second->has_argument ? it->second->parse(optarg) : it->second->parse(nullptr);
+			if(option) {
+				opt_parse_reault = option->has_argument ? option->parse(optarg) : option->parse(nullptr);
 			} else {
 				fprintf(stderr,"Unknown option '%c'\n", opt_char);
 			}
@@ -185,32 +327,182 @@ public:
 			result = result && opt_parse_reault;
 		}
 
+		// getopt_long() has moved the operands to the end.
+		result = parse_operands(argc - optind, argv + optind) && result;
+		result = result && parse_environment();
+		result = result && parse_config();
+		result = result && check_environment();
 		return result && post_validate();
 	}
 
-	std::string options_string() const {
-		std::string result;
-		result.push_back('-');
-		for(const auto& item : _opt_map) {
-			result.push_back(item.first);
+	/**
+	 * @return '-' and the option names, valid until the next finalize().
+	 */
+	const char* options_string() const {
+		return _opt_string;
+	}
+
+	void print_options(FILE* out) {
+		for(size_t idx = 0; idx < _opt_count; ++idx) {
+			_opt_order[idx]->print(out);
+		}
+	}
+
+protected:
+
+	/**
+	 * Parses the @env_prefix variables in one pass over the environment.
+	 */
+	bool parse_environment() {
+		bool result = true;
+		if(_env_prefix == nullptr) {
+			return result;
+		}
+		const std::string_view prefix(_env_prefix);
+		std::string key;
+		for(char** env = environ; *env != nullptr; ++env) {
+			const std::string_view var(*env);
+			const size_t eq = var.find('=');
+			if(eq == std::string_view::npos || var.substr(0, prefix.size()) != prefix) {
+				continue;
+			}
+			key.clear();
+			for(const char ch : var.substr(prefix.size(), eq - prefix.size())) {
+				key.push_back(ch == '_' ? '-' : static_cast<char>(tolower(static_cast<unsigned char>(ch))));
+			}
+			OptionBase* opt = find_key(key);
+			if(opt == nullptr) {
+				fprintf(stderr,"Environment variable '%.*s' is not an option, it is ignored.\n", int(eq), *env);
+			} else if(not parse_value(*opt, *env + eq + 1u, OptionBase::ENVIRONMENT)) {
+				// Reported by check_environment() once the method is known.
+				_env_errors[static_cast<unsigned char>(opt->name)] = *env;
+			}
 		}
 		return result;
 	}
 
-	void print_options(FILE* out) {
-		if(not _opt_map.empty()) {
-			std::map<unsigned, OptionBase*> print_map;
-			for(const auto& item : _opt_map) {
-				print_map.emplace(item.second->print_priority, item.second);
+	/**
+	 * Reports the environment variables which cannot be parsed, if the method uses their options.
+	 */
+	bool check_environment() const {
+		bool result = true;
+		for(size_t idx = 0; idx < OPTION_NAMES; ++idx) {
+			const char* var = _env_errors[idx];
+			if(var && is_used(*_opt_table[idx])) {
+				fprintf(stderr,"Environment variable '%.*s' cannot be parsed.\n", int(strchr(var, '=') - var), var);
+				result = false;
 			}
+		}
+		return result;
+	}
 
-			for(const auto& item : print_map) {
-				item.second->print(out);
+	/**
+	 * Parses the config file : `key = value` lines, '#' starts a comment line.
+	 * The file is read at once and the values are terminated in place.
+	 */
+	bool parse_config() {
+		if(_config == nullptr || (not _config->presented())) {
+			return true;
+		}
+		const char* path = _config->value().c_str();
+		FILE* file = fopen(path, "rb");
+		if(file == nullptr) {
+			fprintf(stderr,"Config file '%s' is not available for reading.\n", path);
+			return false;
+		}
+		std::string text;
+		char block[1u << 14];
+		for(size_t len = fread(block, 1, sizeof(block), file); len > 0; len = fread(block, 1, sizeof(block), file)) {
+			text.append(block, len);
+		}
+		fclose(file);
+
+		bool result = true;
+		size_t line_no = 0;
+		for(size_t pos = 0; pos < text.size();) {
+			const size_t end = std::min(text.find('\n', pos), text.size());
+			const std::string_view line = trim(std::string_view(text).substr(pos, end - pos));
+			pos = end + 1u;
+			++line_no;
+			if(line.empty() || line.front() == '#') {
+				continue;
+			}
+			const size_t eq = line.find('=');
+			bool ok = (eq != std::string_view::npos);
+			if(ok) {
+				const std::string_view value = trim(line.substr(eq + 1u));
+				// The value ends the line, so it can be terminated in place.
+				text[size_t(value.data() - text.data()) + value.size()] = '\0';
+				ok = parse_key(trim(line.substr(0, eq)), value.data(), OptionBase::CONFIG);
 			}
+			if(not ok) {
+				result = false;
+				fprintf(stderr, "Line %zu of '%s' cannot be parsed : %.*s.\n", line_no, path, int(line.size()), line.data());
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * A flag takes a boolean : 1, true, yes, on or 0, false, no, off.
+	 */
+	bool parse_key(const std::string_view& key, const char* value, const OptionBase::Source src) {
+		OptionBase* opt = find_key(key);
+		return opt && parse_value(*opt, value, src);
+	}
+
+	OptionBase* find_key(const std::string_view& key) const {
+		const auto last = _opt_keys.begin() + _key_count;
+		const auto it = std::lower_bound(_opt_keys.begin(), last, key,
+			[](const Key_t& item, const std::string_view& k) { return item.first < k; });
+		return (it == last || it->first != key) ? nullptr : it->second;
+	}
+
+	static bool parse_value(OptionBase& opt, const char* value, const OptionBase::Source src) {
+		if(opt.has_argument) {
+			return opt.parse(value, src);
+		}
+		const std::string_view flag(value);
+		const bool is_on = (flag == "1" || flag == "true" || flag == "yes" || flag == "on");
+		const bool is_off = (flag == "0" || flag == "false" || flag == "no" || flag == "off");
+		if(is_on) {
+			opt.parse(nullptr, src);
+		} else if(is_off) {
+			opt.unset(src);
 		}
+		return is_on || is_off;
 	}
 
-protected:
+	static std::string_view trim(std::string_view str) {
+		while((not str.empty()) && isspace(static_cast<unsigned char>(str.front()))) {
+			str.remove_prefix(1);
+		}
+		while((not str.empty()) && isspace(static_cast<unsigned char>(str.back()))) {
+			str.remove_suffix(1);
+		}
+		return str;
+	}
+
+	OptionBase* find(const char name) const {
+		const auto idx = static_cast<unsigned char>(name);
+		return (idx < OPTION_NAMES) ? _opt_table[idx] : nullptr;
+	}
+
+	/**
+	 * Adds the options of @meth to the table.
+	 */
+	void register_options(const Method& meth) {
+		for(size_t idx = 0; idx < OPTION_NAMES; ++idx) {
+			if(not meth.members.test(idx)) {
+				continue;
+			}
+			if(_opt_table[idx] && _opt_table[idx] != meth.options[idx]) {
+				fprintf(stderr,"Option name '%c' is duplicated.\n", static_cast<char>(idx));
+				assert(false);
+			}
+			_opt_table[idx] = meth.options[idx];
+		}
+	}
 
 	void draw_border(FILE* out, int width_total) const {
 		fprintf(out, "\t");
@@ -222,9 +514,10 @@ protected:
 
 	bool validate_method(const Method& meth) const {
 		bool result = true;
-		for(const auto& item : meth.options) {
-			if(item.mandatory && (not item.opt->presented())) {
-				fprintf(stderr,"Mandatory option '%c' is not presented.\n", item.opt->name);
+		for(size_t idx = 0; idx < _opt_count; ++idx) {
+			const OptionBase* opt = _opt_order[idx];
+			if(meth.mandatory.test(static_cast<unsigned char>(opt->name)) && (not opt->presented())) {
+				fprintf(stderr,"Mandatory option '%c' is not presented.\n", opt->name);
 				result = false;
 			}
 		}
@@ -243,15 +536,15 @@ public:
 	}
 
 	void build_option_map() final {
-		for(const auto& item : _default.options) {
-			const char name = item.opt->name;
-			const auto it = _opt_map.find(name);
-			if(it != _opt_map.end() && it->second != item.opt) {
-				fprintf(stderr,"Option name '%c' is duplicated.\n", name);
-				assert(false);
-			}
-			_opt_map.emplace(name, item.opt);
-		}
+		register_options(_default);
+	}
+
+	bool parse_operands(int, char**) final {
+		return true;
+	}
+
+	bool is_used(const OptionBase&) const final {
+		return true;
 	}
 
 	bool post_validate() const final {
@@ -266,6 +559,9 @@ public:
 };
 
 
+/**
+ * The method is given as the first operand, a subcommand, or by the -m option.
+ */
 template <typename EF>
 struct AppCliMethod : AppCliBasic {
 
@@ -281,15 +577,13 @@ struct AppCliMethod : AppCliBasic {
 	int _width_option;
 
 	Method _methods[EF::size()];
-	Option<EF> _method_opt = Option<EF>(METHOD_NAME, "Method to run.", 0);
+	Option<EF> _method_opt = Option<EF>(METHOD_NAME, "method", "Method to run.", 0);
 
 	AppCliMethod() : _width_method(calc_method_width()) {}
 
 	Method& operator[](const size_t idx) {
-		if(idx < EF::size()) {
-			return _methods[idx];
-		}
-		assert(false);
+		assert(idx < EF::size());
+		return _methods[idx];
 	}
 
 	const EF& action() const {
@@ -297,22 +591,14 @@ struct AppCliMethod : AppCliBasic {
 	}
 
 	void build_option_map() final {
-		_opt_map.emplace(METHOD_NAME, &_method_opt);
+		_opt_table[static_cast<unsigned char>(METHOD_NAME)] = &_method_opt;
 
 		for(size_t i = 0; i < EF::size(); ++i) {
-			if(_methods[i]._desc.empty()) {
+			if(_methods[i]._desc[0] == '\0') {
 				fprintf(stderr,"Method '%s' description is empty.\n", EF::to_cstr(static_cast<E>(i)));
 				assert(false);
 			}
-			for(const auto& item : _methods[i].options) {
-				const char name = item.opt->name;
-				const auto it = _opt_map.find(name);
-				if(it != _opt_map.end() && it->second != item.opt) {
-					fprintf(stderr,"Option name '%c' is duplicated.\n", name);
-					assert(false);
-				}
-				_opt_map.emplace(name, item.opt);
-			}
+			register_options(_methods[i]);
 		}
 
 		_width_description = calc_description_width();
@@ -320,7 +606,7 @@ struct AppCliMethod : AppCliBasic {
 	}
 
 	void print_usage(FILE* out, const char* name) {
-		fprintf(out, "\n%s :\n", name);
+		fprintf(out, "\n%s <method> [options] :\n", name);
 
 		const int width_total = _width_method + _width_description + _width_option + 10;
 		draw_border(out, width_total);
@@ -340,22 +626,25 @@ struct AppCliMethod : AppCliBasic {
 			int opt_width_left = _width_option + 1;
 			fprintf(out, "\t");
 			fprintf(out, "| %-*s ", _width_method, EF::to_cstr(static_cast<E>(i)));
-			fprintf(out, "| %-*s ", _width_description, _methods[i]._desc.c_str());
+			fprintf(out, "| %-*s ", _width_description, _methods[i]._desc);
 			fprintf(out, "| ");
 
-			for (const auto& item: _methods[i].options) {
-				if (item.mandatory) {
-					fprintf(out, "%c", item.opt->name);
+			const Method& meth = _methods[i];
+			for (size_t idx = 0; idx < _opt_count; ++idx) {
+				const char name = _opt_order[idx]->name;
+				if (meth.mandatory.test(static_cast<unsigned char>(name))) {
+					fprintf(out, "%c", name);
 					++cnt_man;
 					--opt_width_left;
 				}
 			}
-			if (cnt_man < _methods[i].options.size()) {
+			if (cnt_man < meth.size()) {
 				opt_width_left -= 2;
 				fprintf(out, "[");
-				for (const auto& item: _methods[i].options) {
-					if (not item.mandatory) {
-						fprintf(out, "%c", item.opt->name);
+				for (size_t idx = 0; idx < _opt_count; ++idx) {
+					const auto name = static_cast<unsigned char>(_opt_order[idx]->name);
+					if (meth.members.test(name) && (not meth.mandatory.test(name))) {
+						fprintf(out, "%c", name);
 						--opt_width_left;
 					}
 				}
@@ -384,7 +673,7 @@ private:
 	int calc_description_width() const {
 		size_t max = strlen(HEADER_DESCRIPTION);
 		for(size_t i = 0; i < EF::size(); ++i) {
-			const auto sl = _methods[i]._desc.size();
+			const auto sl = strlen(_methods[i]._desc);
 			if(sl > max) {
 				max = sl;
 			}
@@ -396,10 +685,8 @@ private:
 		size_t max = strlen(HEADER_OPTIONS);
 		bool has_opt = false;
 		for(size_t i = 0; i < EF::size(); ++i) {
-			auto sl = _methods[i].options.size();
-			for(const auto& it : _methods[i].options) {
-				has_opt = has_opt || it.mandatory;
-			}
+			auto sl = _methods[i].size();
+			has_opt = has_opt || _methods[i].mandatory.any();
 			if(has_opt) {
 				sl += 2u;
 			}
@@ -410,6 +697,30 @@ private:
 		return static_cast<int>(max);
 	}
 
+	bool parse_operands(int argc, char** argv) final {
+		bool result = true;
+		if(argc > 0) {
+			if(_method_opt.presented()) {
+				fprintf(stderr, "Method '%s' is given besides the option '%c'.\n", argv[0], METHOD_NAME);
+				result = false;
+			} else if(not _method_opt.parse(argv[0])) {
+				fprintf(stderr, "Method '%s' is unknown.\n", argv[0]);
+				result = false;
+			}
+		}
+		// The method is the only operand.
+		for(int idx = 1; idx < argc; ++idx) {
+			fprintf(stderr, "Unexpected argument '%s'.\n", argv[idx]);
+			result = false;
+		}
+		return result;
+	}
+
+	bool is_used(const OptionBase& opt) const final {
+		const auto idx = static_cast<size_t>(_method_opt.value().value);
+		return (idx >= EF::size()) || (&opt == &_method_opt) || _methods[idx].members.test(static_cast<unsigned char>(opt.name));
+	}
+
 	bool post_validate() const final {
 		bool result;
 		if(_method_opt.value().get() != EF::size()) {
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Hash.h"
+#include "Stats.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Text-to-speech on a background worker.
+ *
+ * The backend is a shell command template : {text} is replaced by the quoted text.
+ * If the template also has {file}, it is a synthesis command writing into {file} :
+ * the results are cached on disk by the text hash, prefetch() synthesizes ahead
+ * and play() runs the player command on the cached file.
+ * Otherwise the command speaks by itself and prefetch() does nothing.
+ *
+ * A failing backend disables the audio for the rest of the session.
+ * The speech is timed on the worker as the AUDIO phase, the prefetching is not.
+ */
+class AudioPlayer {
+
+	static constexpr const char* TEXT = "{text}";
+	static constexpr const char* FILE_NAME = "{file}";
+	static constexpr const char* EXTENSION = ".mp3";
+
+	const std::string _synth_cmd;
+	const std::string _play_cmd;
+	const bool _use_cache;
+	std::string _cache_dir;
+	Stats& _stats;
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::deque<std::string> _plays;
+	std::deque<std::string> _prefetches;
+	std::unordered_set<std::string> _requested;
+	bool _stop;
+	bool _failed;
+
+	std::thread _worker;
+
+public:
+
+	AudioPlayer(std::string synth_cmd, std::string play_cmd, Stats& stats) :
+		_synth_cmd(std::move(synth_cmd)),
+		_play_cmd(std::move(play_cmd)),
+		_use_cache(_synth_cmd.find(FILE_NAME) != std::string::npos),
+		_stats(stats),
+		_stop(false),
+		_failed(false) {
+		if(_use_cache && (not prepare_cache_dir())) {
+			fprintf(stderr, "Audio cache directory '%s' is not available.\n", _cache_dir.c_str());
+			_failed = true;
+		}
+		_worker = std::thread([this]() { work(); });
+	}
+
+	AudioPlayer(const AudioPlayer&) = delete;
+	AudioPlayer& operator=(const AudioPlayer&) = delete;
+
+	/**
+	 * Waits for the queued speech, the pending prefetching is dropped.
+	 */
+	~AudioPlayer() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+			_prefetches.clear();
+		}
+		_cv.notify_one();
+		_worker.join();
+	}
+
+	/**
+	 * Queues @text to be spoken, it takes precedence over the prefetching.
+	 */
+	void play(const std::string_view& text) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_failed) {
+				return;
+			}
+			_plays.emplace_back(text);
+		}
+		_cv.notify_one();
+	}
+
+	/**
+	 * Queues the synthesis of @text into the cache.
+	 */
+	void prefetch(const std::string_view& text) {
+		if(not _use_cache) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_failed || (not _requested.emplace(text).second)) {
+				return;
+			}
+			_prefetches.emplace_back(text);
+		}
+		_cv.notify_one();
+	}
+
+private:
+
+	void work() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		while(true) {
+			_cv.wait(lock, [this]() { return _stop || (not _plays.empty()) || (not _prefetches.empty()); });
+			if(_stop && _plays.empty()) {
+				break;
+			}
+			const bool is_play = not _plays.empty();
+			std::deque<std::string>& queue = is_play ? _plays : _prefetches;
+			const std::string text = std::move(queue.front());
+			queue.pop_front();
+			if(_failed) {
+				continue;
+			}
+
+			lock.unlock();
+			const auto start = _stats.now();
+			bool ok;
+			if(_use_cache) {
+				const std::string path = cache_path(text);
+				ok = synthesize(text, path) && ((not is_play) || run(substitute(_play_cmd, FILE_NAME, shell_quote(path))));
+			} else {
+				ok = run(substitute(_synth_cmd, TEXT, shell_quote(text)));
+			}
+			if(is_play) {
+				_stats.add(Stats::AUDIO, start);
+			}
+			lock.lock();
+
+			if(not ok) {
+				_failed = true;
+				_plays.clear();
+				_prefetches.clear();
+				fprintf(stderr, "\nAudio backend fails, the audio is disabled.\n");
+			}
+		}
+	}
+
+	/**
+	 * Synthesizes @text into @path unless it is cached already.
+	 * The file is written under a temporary name, an interrupted synthesis leaves no entry.
+	 */
+	bool synthesize(const std::string& text, const std::string& path) const {
+		bool result = (access(path.c_str(), R_OK) == 0);
+		if(not result) {
+			const std::string tmp_path = path + ".tmp" + std::to_string(getpid()) + EXTENSION;
+			std::string cmd = substitute(_synth_cmd, TEXT, shell_quote(text));
+			cmd = substitute(cmd, FILE_NAME, shell_quote(tmp_path));
+			result = run(cmd) && (rename(tmp_path.c_str(), path.c_str()) == 0);
+			if(not result) {
+				remove(tmp_path.c_str());
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * The key is the hash of the synthesis command and the text, another voice or backend does not reuse the files.
+	 */
+	std::string cache_path(const std::string& text) const {
+		Fnv1a hash;
+		hash.mix(_synth_cmd.c_str(), _synth_cmd.size() + 1u);
+		hash.mix(text);
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx", static_cast<unsigned long long>(hash.value));
+		return _cache_dir + name + EXTENSION;
+	}
+
+	/**
+	 * $XDG_CACHE_HOME/nihongo-no-tango or ~/.cache/nihongo-no-tango.
+	 */
+	bool prepare_cache_dir() {
+		const char* xdg = getenv("XDG_CACHE_HOME");
+		const char* home = getenv("HOME");
+		if(xdg && *xdg) {
+			_cache_dir = xdg;
+		} else if(home && *home) {
+			_cache_dir = std::string(home) + "/.cache";
+		} else {
+			_cache_dir = "/tmp";
+		}
+		mkdir(_cache_dir.c_str(), 0755);
+		_cache_dir.append("/nihongo-no-tango");
+		mkdir(_cache_dir.c_str(), 0755);
+		return access(_cache_dir.c_str(), W_OK) == 0;
+	}
+
+	static bool run(const std::string& cmd) {
+		return system(cmd.c_str()) == EXIT_SUCCESS;
+	}
+
+	static std::string substitute(const std::string& tmpl, const char* key, const std::string& value) {
+		std::string result;
+		const std::string_view key_view(key);
+		size_t pos = 0;
+		for(size_t found = tmpl.find(key_view); found != std::string::npos; found = tmpl.find(key_view, pos)) {
+			result.append(tmpl, pos, found - pos);
+			result.append(value);
+			pos = found + key_view.size();
+		}
+		result.append(tmpl, pos, std::string::npos);
+		return result;
+	}
+
+	static std::string shell_quote(const std::string_view& str) {
+		std::string result("'");
+		for(const char ch : str) {
+			if(ch == '\'') {
+				result.append("'\\''");
+			} else {
+				result.push_back(ch);
+			}
+		}
+		result.push_back('\'');
+		return result;
+	}
+
+};
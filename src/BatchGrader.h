@@ -0,0 +1,187 @@
+#pragma once
+
+#include "AnswerMatcher.h"
+#include "DictionaryStore.h"
+#include "HashIndex.h"
+#include "KatakanaFilter.h"
+#include "Parallel.h"
+#include "Record.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <initializer_list>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Grades `<key>\t<answer>` lines against the dictionary without interaction.
+ *
+ * The key is the kanji or the kana of a record, an answer to a key shared by several
+ * records is right if it matches any of them. The lines are graded in chunks on
+ * the worker threads, the results are written in the input order.
+ */
+class BatchGrader {
+public:
+
+	enum Verdict : uint8_t {
+		CORRECT,
+		WRONG,
+		UNKNOWN,
+		MALFORMED
+	};
+
+	struct Stat {
+		size_t items = 0;
+		size_t verdicts[MALFORMED + 1u] = {0, 0, 0, 0};
+	};
+
+private:
+
+	static constexpr char SEPARATOR = '\t';
+	static constexpr size_t CHUNK_LINES = 4096;
+	static constexpr size_t OUTPUT_FLUSH = 1u << 16;
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	struct Item {
+		std::string_view key;
+		std::string_view answer;
+		uint32_t record;
+		Verdict verdict;
+	};
+
+	const DictionaryStore& _dic;
+	const HashIndex& _index;
+	const AnswerMatcher& _matcher;
+	const KatakanaFilter* const _filter;
+
+public:
+
+	/**
+	 * @param matcher - the prototype of the matchers of the workers.
+	 * @param filter - the katakana filter of the both sides, nullptr to skip it.
+	 */
+	BatchGrader(const DictionaryStore& dic, const HashIndex& index, const AnswerMatcher& matcher, const KatakanaFilter* filter) :
+		_dic(dic), _index(index), _matcher(matcher), _filter(filter) {}
+
+	/**
+	 * Grades the lines of @text and writes `<key>\t<answer>\t<verdict>\t<reference>` lines into @out.
+	 * @param reference - returns the reference field of a record.
+	 */
+	template <typename Reference>
+	Stat grade(const std::string_view& text, FILE* out, const unsigned threads, Reference&& reference) const {
+		std::vector<Item> items;
+		split(text, items);
+
+		const size_t chunks = (items.size() + CHUNK_LINES - 1u) / CHUNK_LINES;
+		Parallel::for_each(chunks, Parallel::concurrency(threads), [&](const size_t chunk) {
+			AnswerMatcher matcher(_matcher);
+			std::u32string answer;
+			std::u32string expected;
+			const size_t last = std::min(items.size(), (chunk + 1u) * CHUNK_LINES);
+			for(size_t idx = chunk * CHUNK_LINES; idx < last; ++idx) {
+				grade_one(items[idx], matcher, answer, expected, reference);
+			}
+		});
+
+		Stat stat;
+		std::string buf;
+		buf.reserve(OUTPUT_FLUSH + 1024u);
+		for(const Item& item : items) {
+			++stat.items;
+			++stat.verdicts[item.verdict];
+			buf.append(item.key);
+			buf.push_back(SEPARATOR);
+			buf.append(item.answer);
+			buf.push_back(SEPARATOR);
+			buf.append(to_cstr(item.verdict));
+			buf.push_back(SEPARATOR);
+			if(item.record != NONE) {
+				buf.append(reference(_dic[item.record]));
+			}
+			buf.push_back('\n');
+			if(buf.size() >= OUTPUT_FLUSH) {
+				fwrite(buf.data(), 1, buf.size(), out);
+				buf.clear();
+			}
+		}
+		fwrite(buf.data(), 1, buf.size(), out);
+		return stat;
+	}
+
+	static const char* to_cstr(const Verdict verdict) {
+		switch(verdict) {
+			case CORRECT: return "correct";
+			case WRONG: return "wrong";
+			case UNKNOWN: return "unknown";
+			case MALFORMED: return "malformed";
+			default: return "[UNKNOWN]";
+		}
+	}
+
+private:
+
+	/**
+	 * Splits @text into the items, the empty lines are skipped.
+	 */
+	static void split(const std::string_view& text, std::vector<Item>& items) {
+		for(size_t pos = 0; pos < text.size();) {
+			const size_t end = std::min(text.find('\n', pos), text.size());
+			std::string_view line = text.substr(pos, end - pos);
+			pos = end + 1u;
+			if((not line.empty()) && line.back() == '\r') {
+				line.remove_suffix(1);
+			}
+			if(line.empty()) {
+				continue;
+			}
+			Item item;
+			const size_t sep = line.find(SEPARATOR);
+			item.key = line.substr(0, sep);
+			item.answer = (sep == std::string_view::npos) ? std::string_view() : line.substr(sep + 1u);
+			item.record = NONE;
+			item.verdict = (sep == std::string_view::npos) ? MALFORMED : UNKNOWN;
+			items.push_back(item);
+		}
+	}
+
+	template <typename Reference>
+	void grade_one(Item& item, AnswerMatcher& matcher, std::u32string& answer, std::u32string& expected, Reference& reference) const {
+		if(item.verdict == MALFORMED) {
+			return;
+		}
+		if(not Utf8::decode(item.answer, answer)) {
+			item.verdict = MALFORMED;
+			return;
+		}
+		filter(answer);
+		for(const auto field : {HashIndex::KANJI, HashIndex::KANA}) {
+			for(uint32_t idx = _index.find(field, item.key); idx != HashIndex::NONE; idx = _index.next(field, idx)) {
+				const Record rec = _dic[idx];
+				if(field == HashIndex::KANA && rec.kanji == item.key) {
+					continue;
+				}
+				Utf8::decode(reference(rec), expected);
+				filter(expected);
+				if(item.record == NONE) {
+					item.record = idx;
+					item.verdict = WRONG;
+				}
+				if(matcher.match(answer, expected)) {
+					item.record = idx;
+					item.verdict = CORRECT;
+					return;
+				}
+			}
+		}
+	}
+
+	void filter(std::u32string& text) const {
+		if(_filter) {
+			_filter->apply(text);
+		}
+	}
+
+};
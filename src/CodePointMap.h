@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Two-level remapping table for the Basic Multilingual Plane.
+ *
+ * A 256-entry page index points to remapped pages, unmapped pages are identity.
+ * The table can be built in a constant expression and extended at run time
+ * while there are free pages. A code point mapped to DROP is removed by the users.
+ */
+template <size_t PAGES>
+class CodePointMap {
+
+	static constexpr size_t PAGE_SIZE = 256;
+	static constexpr char32_t BMP_END = 0x10000;
+
+	std::array<uint8_t, PAGE_SIZE> _page_of;
+	std::array<std::array<char32_t, PAGE_SIZE>, PAGES + 1u> _pages;
+	size_t _used;
+
+	static_assert(PAGES < PAGE_SIZE, "Page slots must fit into uint8_t.");
+
+public:
+
+	static constexpr char32_t DROP = 0;
+
+	constexpr CodePointMap() : _page_of(), _pages(), _used(1) {}
+
+	/**
+	 * @return false if @from is outside of the BMP or there is no free page left.
+	 */
+	constexpr bool set(const char32_t from, const char32_t to) {
+		bool result = (from < BMP_END);
+		if(result) {
+			const size_t page = from / PAGE_SIZE;
+			if(_page_of[page] == 0) {
+				result = (_used <= PAGES);
+				if(result) {
+					for(size_t i = 0; i < PAGE_SIZE; ++i) {
+						_pages[_used][i] = static_cast<char32_t>(page * PAGE_SIZE + i);
+					}
+					_page_of[page] = static_cast<uint8_t>(_used++);
+				}
+			}
+			if(result) {
+				_pages[_page_of[page]][from % PAGE_SIZE] = to;
+			}
+		}
+		return result;
+	}
+
+	constexpr bool set_range(const char32_t first, const char32_t last, const char32_t to_first) {
+		bool result = true;
+		for(char32_t cp = first; result && cp <= last; ++cp) {
+			result = set(cp, to_first + (cp - first));
+		}
+		return result;
+	}
+
+	constexpr char32_t operator()(const char32_t cp) const {
+		if(cp >= BMP_END) {
+			return cp;
+		}
+		const size_t slot = _page_of[cp / PAGE_SIZE];
+		return (slot == 0) ? cp : _pages[slot][cp % PAGE_SIZE];
+	}
+
+	constexpr size_t pages_used() const {
+		return _used - 1u;
+	}
+
+};
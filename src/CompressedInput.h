@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <zlib.h>
+
+/**
+ * Detection and streaming decompression of the compressed dictionaries.
+ *
+ * gzip is inflated on a second thread into blocks cut at line breaks, the caller
+ * consumes a block while the next ones are being inflated. At most BLOCKS blocks
+ * are in flight, so the memory does not depend on the inflated size.
+ */
+class CompressedInput {
+public:
+
+	enum Format : unsigned {
+		PLAIN,
+		GZIP,
+		ZSTD
+	};
+
+	/**
+	 * @return The format of @data by its magic bytes.
+	 */
+	static Format detect(const std::string_view& data) {
+		const auto byte = [&data](const size_t idx) { return static_cast<unsigned char>(data[idx]); };
+		if(data.size() >= 2u && byte(0) == 0x1Fu && byte(1) == 0x8Bu) {
+			return GZIP;
+		}
+		if(data.size() >= 4u && byte(0) == 0x28u && byte(1) == 0xB5u && byte(2) == 0x2Fu && byte(3) == 0xFDu) {
+			return ZSTD;
+		}
+		return PLAIN;
+	}
+
+	static const char* to_cstr(const Format format) {
+		switch(format) {
+			case PLAIN: return "plain";
+			case GZIP: return "gzip";
+			case ZSTD: return "zstd";
+			default: return "[UNKNOWN]";
+		}
+	}
+
+	/**
+	 * @return The inflated size of the gzip @data recorded in its trailer, modulo 4 GiB.
+	 * A hint only : a multi-member file records the size of the last member.
+	 */
+	static size_t size_hint(const std::string_view& data) {
+		size_t result = 0;
+		for(size_t i = 0; data.size() >= 4u && i < 4u; ++i) {
+			result |= size_t(static_cast<unsigned char>(data[data.size() - 4u + i])) << (8u * i);
+		}
+		return result;
+	}
+
+	/**
+	 * Inflates the gzip @data, @consume is called on the calling thread with every block in order.
+	 * A block ends with a line break except the last one.
+	 * @return false if the data is corrupt or truncated, the complete lines before the error are consumed.
+	 */
+	template <typename Consume>
+	static bool inflate(const std::string_view& data, Consume&& consume) {
+		Pipe pipe;
+		bool result = true;
+		std::thread producer([&data, &pipe, &result]() { result = produce(data, pipe); });
+		for(std::string* block = pipe.pop(); block != nullptr; block = pipe.pop()) {
+			consume(std::string_view(*block));
+			pipe.recycle(block);
+		}
+		producer.join();
+		return result;
+	}
+
+	/**
+	 * Inflates the whole gzip @data into @out.
+	 */
+	static bool inflate(const std::string_view& data, std::string& out) {
+		out.clear();
+		out.reserve(size_hint(data));
+		return inflate(data, [&out](const std::string_view& block) { out.append(block); });
+	}
+
+private:
+
+	static constexpr size_t BLOCK_SIZE = 1u << 20;
+	static constexpr size_t BLOCKS = 4;
+	static constexpr size_t SLICE_MAX = UINT_MAX;
+
+	/**
+	 * Bounded hand-off of the blocks between the inflating thread and the consumer.
+	 */
+	class Pipe {
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::string _blocks[BLOCKS];
+		std::deque<std::string*> _free;
+		std::deque<std::string*> _ready;
+		bool _closed;
+
+	public:
+
+		Pipe() : _closed(false) {
+			for(auto& block : _blocks) {
+				_free.push_back(&block);
+			}
+		}
+
+		/**
+		 * Waits for a block which is not in use.
+		 */
+		std::string* acquire() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [this]() { return not _free.empty(); });
+			std::string* result = _free.front();
+			_free.pop_front();
+			return result;
+		}
+
+		void push(std::string* block) {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_ready.push_back(block);
+			}
+			_cv.notify_all();
+		}
+
+		void close() {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_closed = true;
+			}
+			_cv.notify_all();
+		}
+
+		/**
+		 * @return The next block, nullptr after the last one.
+		 */
+		std::string* pop() {
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [this]() { return _closed || (not _ready.empty()); });
+			std::string* result = nullptr;
+			if(not _ready.empty()) {
+				result = _ready.front();
+				_ready.pop_front();
+			}
+			return result;
+		}
+
+		void recycle(std::string* block) {
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_free.push_back(block);
+			}
+			_cv.notify_all();
+		}
+
+	};
+
+	static bool produce(const std::string_view& data, Pipe& pipe) {
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+		// 32 - the gzip and zlib headers are detected automatically.
+		bool result = (inflateInit2(&zs, MAX_WBITS + 32) == Z_OK);
+		bool finished = not result;
+		size_t in_pos = 0;
+		std::string tail;
+		while(not finished) {
+			std::string* block = pipe.acquire();
+			size_t len = tail.size();
+			block->assign(tail);
+			block->resize(std::max(BLOCK_SIZE, len * 2u));
+			// A block is filled up, then cut after its last line break; a longer line grows it.
+			size_t cut = std::string::npos;
+			while(cut == std::string::npos && not finished) {
+				if(len == block->size()) {
+					block->resize(len * 2u);
+				}
+				result = inflate_some(zs, data, in_pos, *block, len, finished);
+				finished = finished || (not result);
+				if(len == block->size()) {
+					const void* eol = memrchr(block->data(), '\n', len);
+					cut = eol ? size_t(static_cast<const char*>(eol) - block->data()) + 1u : std::string::npos;
+				}
+			}
+			if(not result) {
+				const void* eol = memrchr(block->data(), '\n', len);
+				cut = eol ? size_t(static_cast<const char*>(eol) - block->data()) + 1u : 0u;
+			} else if(finished) {
+				cut = len;
+			}
+			tail.assign(block->data() + cut, len - cut);
+			block->resize(cut);
+			pipe.push(block);
+		}
+		inflateEnd(&zs);
+		pipe.close();
+		return result;
+	}
+
+	/**
+	 * Inflates into @block from @len on, at most SLICE_MAX bytes in and out.
+	 * @param finished - set after the last member of the input.
+	 */
+	static bool inflate_some(z_stream& zs, const std::string_view& data, size_t& in_pos, std::string& block, size_t& len, bool& finished) {
+		if(zs.avail_in == 0 && in_pos < data.size()) {
+			const size_t slice = std::min(data.size() - in_pos, SLICE_MAX);
+			zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data() + in_pos));
+			zs.avail_in = static_cast<uInt>(slice);
+			in_pos += slice;
+		}
+		const size_t room = std::min(block.size() - len, SLICE_MAX);
+		zs.next_out = reinterpret_cast<Bytef*>(&block[len]);
+		zs.avail_out = static_cast<uInt>(room);
+		const int ret = ::inflate(&zs, Z_NO_FLUSH);
+		len += room - zs.avail_out;
+
+		bool result = true;
+		const bool is_input_end = (zs.avail_in == 0 && in_pos == data.size());
+		if(ret == Z_STREAM_END) {
+			// The members of a concatenated gzip file are inflated one after another.
+			if(is_input_end) {
+				finished = true;
+			} else {
+				result = (inflateReset(&zs) == Z_OK);
+			}
+		} else if(ret == Z_BUF_ERROR) {
+			// No progress is possible at the end of the input : it is truncated.
+			result = not is_input_end;
+		} else {
+			result = (ret == Z_OK);
+		}
+		return result;
+	}
+
+};
@@ -2,6 +2,9 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <utility>
 
 /**
  * Provides an independent stream of pseudo-random numbers.
@@ -37,4 +40,49 @@ public:
 		return jrand48(m_seed);
 	}
 
+	uint32_t next_u32() {
+		return static_cast<uint32_t>(jrand48(m_seed));
+	}
+
+	uint64_t next_u64() {
+		return (uint64_t(next_u32()) << uint64_t(32)) | next_u32();
+	}
+
+	/**
+	 * @param bound - must be positive.
+	 * @return A number uniformly distributed in [0, bound).
+	 * Multiply-shift with rejection (Lemire), there is no modulo bias.
+	 */
+	uint64_t uniform(const uint64_t bound) {
+		unsigned __int128 m = (unsigned __int128)next_u64() * bound;
+		uint64_t low = static_cast<uint64_t>(m);
+		if(low < bound) {
+			const uint64_t threshold = (0 - bound) % bound;
+			while(low < threshold) {
+				m = (unsigned __int128)next_u64() * bound;
+				low = static_cast<uint64_t>(m);
+			}
+		}
+		return static_cast<uint64_t>(m >> 64);
+	}
+
+	/**
+	 * Moves @k uniformly chosen elements of [first, last) to its beginning, in random order.
+	 * Partial Fisher-Yates shuffle, O(k) swaps.
+	 * @return The end of the sample.
+	 */
+	template <typename It>
+	It sample(It first, It last, size_t k) {
+		const auto n = static_cast<size_t>(std::distance(first, last));
+		k = (k < n) ? k : n;
+		for(size_t i = 0; i < k; ++i) {
+			const auto j = static_cast<size_t>(i + uniform(n - i));
+			if(j != i) {
+				using std::swap;
+				swap(*(first + i), *(first + j));
+			}
+		}
+		return first + k;
+	}
+
 };
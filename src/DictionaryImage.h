@@ -0,0 +1,222 @@
+#pragma once
+
+#include "DictionaryStore.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "SuffixIndex.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <sys/stat.h>
+
+/**
+ * Precompiled dictionary image.
+ *
+ * Layout : Header | Entry[record_count] | string pool | SuffixIndex::Suffix[suffix_count].
+ * The image is written in the native byte order and is mapped as is,
+ * it is bound to the source file by its size and modification time.
+ */
+class DictionaryImage {
+public:
+
+	static constexpr const char* SUFFIX = ".bin";
+
+	static std::string path_for(const std::string& source) {
+		return source + SUFFIX;
+	}
+
+	/**
+	 * Writes the store into @path.
+	 * The image is built in a temporary file and renamed, a reader never sees a partial image.
+	 * @return false on an I/O error.
+	 */
+	static bool write(const char* path, const DictionaryStore& store, const SuffixIndex& suffixes, const struct stat& source) {
+		Header hdr;
+		fill_header(hdr, source);
+		hdr.record_count = store.size();
+		hdr.entries_offset = align(sizeof(Header));
+		hdr.pool_offset = hdr.entries_offset + store.size() * sizeof(DictionaryStore::Entry);
+		hdr.pool_size = store.pool_size();
+		hdr.suffixes_offset = align(hdr.pool_offset + hdr.pool_size);
+		hdr.suffix_count = suffixes.size();
+		hdr.checksum = checksum(store.begin(), store.size(), store.pool(), suffixes.begin(), suffixes.size());
+
+		const std::string tmp_path = std::string(path) + ".tmp";
+		FILE* file = fopen(tmp_path.c_str(), "wb");
+		bool result = (file != nullptr);
+		if(result) {
+			static const char padding[ALIGNMENT] = {};
+			result = result && (fwrite(&hdr, sizeof(hdr), 1, file) == 1);
+			const size_t padding_size = hdr.entries_offset - sizeof(hdr);
+			result = result && (padding_size == 0 || fwrite(padding, padding_size, 1, file) == 1);
+			result = result && (store.empty() || fwrite(store.begin(), sizeof(DictionaryStore::Entry), store.size(), file) == store.size());
+			result = result && (store.pool_size() == 0 || fwrite(store.pool().data(), store.pool_size(), 1, file) == 1);
+			const size_t pool_padding = hdr.suffixes_offset - (hdr.pool_offset + hdr.pool_size);
+			result = result && (pool_padding == 0 || fwrite(padding, pool_padding, 1, file) == 1);
+			result = result && (suffixes.empty() || fwrite(suffixes.begin(), sizeof(SuffixIndex::Suffix), suffixes.size(), file) == suffixes.size());
+			result = (fclose(file) == 0) && result;
+			result = result && (rename(tmp_path.c_str(), path) == 0);
+			if(not result) {
+				remove(tmp_path.c_str());
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Maps the image into @store without parsing it, the suffix array goes into @suffixes if it is given.
+	 * The entries and the suffixes are bounds-checked against the pool, a linear scan without hashing.
+	 * @return false if the image is absent, malformed or stale relative to @source.
+	 */
+	static bool read(const char* path, const struct stat& source, DictionaryStore& store, SuffixIndex* suffixes = nullptr) {
+		MappedFile image;
+		bool result = image.open(path, true) && (image.size() >= sizeof(Header));
+		if(result) {
+			Header expected;
+			fill_header(expected, source);
+			const auto* hdr = reinterpret_cast<const Header*>(image.data());
+			result = is_compatible(*hdr, expected);
+			result = result && (hdr->entries_offset == align(sizeof(Header)));
+			result = result && (hdr->record_count <= image.size() / sizeof(DictionaryStore::Entry));
+			result = result && (hdr->pool_offset == hdr->entries_offset + hdr->record_count * sizeof(DictionaryStore::Entry));
+			result = result && (hdr->pool_offset <= image.size()) && (hdr->pool_size <= image.size() - hdr->pool_offset);
+			result = result && (hdr->suffixes_offset == align(hdr->pool_offset + hdr->pool_size));
+			result = result && (hdr->suffix_count <= image.size() / sizeof(SuffixIndex::Suffix));
+			result = result && (hdr->suffixes_offset + hdr->suffix_count * sizeof(SuffixIndex::Suffix) == image.size());
+			if(result) {
+				char* base = image.data();
+				const char* pool = base + hdr->pool_offset;
+				const size_t pool_size = hdr->pool_size;
+				auto* entries = reinterpret_cast<DictionaryStore::Entry*>(base + hdr->entries_offset);
+				const size_t count = hdr->record_count;
+				const auto* suffix_array = reinterpret_cast<const SuffixIndex::Suffix*>(base + hdr->suffixes_offset);
+				const size_t suffix_count = hdr->suffix_count;
+				result = is_valid(entries, count, pool_size) && is_valid(suffix_array, suffix_count, entries, count);
+				if(result) {
+					store.attach(std::move(image), pool, pool_size, entries, count);
+					if(suffixes) {
+						suffixes->attach(store, suffix_array, suffix_count);
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Recomputes the checksum of the whole image.
+	 * This is a full scan, it is not a part of read().
+	 */
+	static bool verify(const char* path) {
+		MappedFile image;
+		bool result = image.open(path) && (image.size() >= sizeof(Header));
+		if(result) {
+			const char* base = image.data();
+			const auto* hdr = reinterpret_cast<const Header*>(base);
+			result = (hdr->suffix_count <= image.size() / sizeof(SuffixIndex::Suffix));
+			result = result && (hdr->suffixes_offset + hdr->suffix_count * sizeof(SuffixIndex::Suffix) == image.size());
+			result = result && (hdr->suffixes_offset >= hdr->pool_offset + hdr->pool_size);
+			result = result && (hdr->record_count <= image.size() / sizeof(DictionaryStore::Entry));
+			result = result && (hdr->pool_offset >= hdr->entries_offset + hdr->record_count * sizeof(DictionaryStore::Entry));
+			if(result) {
+				const auto* entries = reinterpret_cast<const DictionaryStore::Entry*>(base + hdr->entries_offset);
+				const std::string_view pool(base + hdr->pool_offset, hdr->pool_size);
+				const auto* suffixes = reinterpret_cast<const SuffixIndex::Suffix*>(base + hdr->suffixes_offset);
+				result = (checksum(entries, hdr->record_count, pool, suffixes, hdr->suffix_count) == hdr->checksum);
+			}
+		}
+		return result;
+	}
+
+private:
+
+	static constexpr char MAGIC[8] = {'N', 'N', 'T', 'D', 'I', 'C', 'T', '\0'};
+	static constexpr uint32_t VERSION = 2;
+	static constexpr size_t ALIGNMENT = 16;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t entry_size;
+		uint64_t source_size;
+		int64_t source_mtime_sec;
+		int64_t source_mtime_nsec;
+		uint64_t record_count;
+		uint64_t entries_offset;
+		uint64_t pool_offset;
+		uint64_t pool_size;
+		uint64_t suffixes_offset;
+		uint64_t suffix_count;
+		uint64_t checksum;
+	};
+
+	static void fill_header(Header& hdr, const struct stat& source) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+		hdr.version = VERSION;
+		hdr.entry_size = sizeof(DictionaryStore::Entry);
+		hdr.source_size = static_cast<uint64_t>(source.st_size);
+		hdr.source_mtime_sec = source.st_mtim.tv_sec;
+		hdr.source_mtime_nsec = source.st_mtim.tv_nsec;
+	}
+
+	static bool is_compatible(const Header& hdr, const Header& expected) {
+		return memcmp(hdr.magic, expected.magic, sizeof(MAGIC)) == 0
+			&& hdr.version == expected.version
+			&& hdr.entry_size == expected.entry_size
+			&& hdr.source_size == expected.source_size
+			&& hdr.source_mtime_sec == expected.source_mtime_sec
+			&& hdr.source_mtime_nsec == expected.source_mtime_nsec;
+	}
+
+	/**
+	 * @return true if the fields of every entry are inside the pool.
+	 */
+	static bool is_valid(const DictionaryStore::Entry* entries, const size_t count, const size_t pool_size) {
+		bool result = true;
+		for(size_t idx = 0; result && idx < count; ++idx) {
+			const DictionaryStore::Entry& entry = entries[idx];
+			const size_t len = size_t(entry.kanji_len) + entry.kana_len + entry.translation_len;
+			result = (entry.offset <= pool_size) && (len <= pool_size - entry.offset);
+		}
+		return result;
+	}
+
+	/**
+	 * @return true if every suffix starts inside the fields of its record.
+	 */
+	static bool is_valid(const SuffixIndex::Suffix* suffixes, const size_t suffix_count, const DictionaryStore::Entry* entries, const size_t count) {
+		bool result = true;
+		for(size_t idx = 0; result && idx < suffix_count; ++idx) {
+			const SuffixIndex::Suffix& sfx = suffixes[idx];
+			result = (sfx.record < count);
+			if(result) {
+				const DictionaryStore::Entry& entry = entries[sfx.record];
+				const size_t len = size_t(entry.kanji_len) + entry.kana_len + entry.translation_len;
+				result = (sfx.pos >= entry.offset) && (sfx.pos - entry.offset < len);
+			}
+		}
+		return result;
+	}
+
+	static constexpr uint64_t align(const uint64_t value) {
+		return (value + ALIGNMENT - 1u) & ~uint64_t(ALIGNMENT - 1u);
+	}
+
+	/**
+	 * FNV-1a over the entries, the pool and the suffixes.
+	 */
+	static uint64_t checksum(const DictionaryStore::Entry* entries, const size_t count, const std::string_view& pool,
+		const SuffixIndex::Suffix* suffixes, const size_t suffix_count) {
+		Fnv1a hash;
+		hash.mix(entries, count * sizeof(DictionaryStore::Entry));
+		hash.mix(pool);
+		hash.mix(suffixes, suffix_count * sizeof(SuffixIndex::Suffix));
+		return hash.value;
+	}
+
+};
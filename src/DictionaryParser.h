@@ -0,0 +1,190 @@
+#pragma once
+
+#include "DictionaryStore.h"
+#include "Parallel.h"
+#include "Record.h"
+#include "Utf8.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+/**
+ * Parser of the text dictionary format : one `kanji;kana;translation` record per line,
+ * lines starting with '/' are comments.
+ *
+ * Large inputs are cut at line boundaries into chunks parsed concurrently,
+ * the chunks are merged in the original order.
+ */
+class DictionaryParser {
+
+	static constexpr size_t CHUNK_MIN = 1u << 20;
+	static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+	struct Error {
+		size_t line;
+		std::string_view text;
+	};
+
+	struct Chunk {
+		std::string_view text;
+		DictionaryStore own;
+		DictionaryStore* store = &own;
+		std::vector<Error> errors;
+		size_t lines = 0;
+	};
+
+public:
+
+	/**
+	 * Appends the records of @text to @dic.
+	 * Every malformed line is reported to stderr with its line number.
+	 * @return The number of malformed lines.
+	 */
+	static size_t parse(const std::string_view& text, DictionaryStore& dic, const unsigned threads) {
+		const unsigned workers = Parallel::concurrency(threads);
+		size_t chunk_cnt = std::max<size_t>(1u, std::min(text.size() / CHUNK_MIN, size_t(workers) * CHUNKS_PER_THREAD));
+		if(workers == 1u) {
+			chunk_cnt = 1u;
+		}
+
+		std::vector<Chunk> chunks(chunk_cnt);
+		split(text, chunks);
+		if(chunks.size() == 1u) {
+			chunks.front().store = &dic;
+		}
+
+		Parallel::for_each(chunks.size(), workers, [&chunks](const size_t idx) {
+			parse_chunk(chunks[idx]);
+		});
+
+		if(chunks.size() > 1u) {
+			size_t records = 0;
+			size_t pool_bytes = 0;
+			for(const auto& chunk : chunks) {
+				records += chunk.own.size();
+				pool_bytes += chunk.own.pool_size();
+			}
+			dic.reserve(dic.size() + records, dic.pool_size() + pool_bytes);
+		}
+
+		size_t line_base = 0;
+		size_t error_cnt = 0;
+		for(auto& chunk : chunks) {
+			for(const auto& err : chunk.errors) {
+				report(line_base + err.line, err.text);
+			}
+			error_cnt += chunk.errors.size();
+			if(chunk.store != &dic) {
+				if(not dic.append(chunk.own)) {
+					fprintf(stderr, "Dictionary is too large, records after line %zu are dropped.\n", line_base);
+					break;
+				}
+				chunk.own.clear();
+			}
+			line_base += chunk.lines;
+		}
+		return error_cnt;
+	}
+
+	/**
+	 * Incremental parsing of a text which comes in blocks, e.g. from a decompressor.
+	 * Every block must end with a line break, except the last one.
+	 */
+	class Stream {
+		DictionaryStore& _dic;
+		size_t _reserved;
+		size_t _lines;
+		size_t _errors;
+
+	public:
+
+		/**
+		 * @param size_hint - the expected size of the whole text, 0 if unknown.
+		 */
+		Stream(DictionaryStore& dic, const size_t size_hint) : _dic(dic), _reserved(size_hint), _lines(0), _errors(0) {
+			_dic.reserve(_dic.size(), _dic.pool_size() + size_hint);
+		}
+
+		/**
+		 * Appends the records of @block to the dictionary.
+		 */
+		void feed(const std::string_view& block) {
+			// The arena grows geometrically, reserving block by block would copy it every time.
+			if(_dic.pool_size() + block.size() > _reserved) {
+				_reserved = (_dic.pool_size() + block.size()) * 2u;
+				_dic.reserve(_dic.size(), _reserved);
+			}
+			Chunk chunk;
+			chunk.text = block;
+			chunk.store = &_dic;
+			parse_chunk(chunk);
+			for(const auto& err : chunk.errors) {
+				report(_lines + err.line, err.text);
+			}
+			_errors += chunk.errors.size();
+			_lines += chunk.lines;
+		}
+
+		/**
+		 * @return The number of malformed lines.
+		 */
+		size_t errors() const {
+			return _errors;
+		}
+
+	};
+
+private:
+
+	/**
+	 * Cuts @text into chunks of about the same size, each one ending with a line break.
+	 */
+	static void split(const std::string_view& text, std::vector<Chunk>& chunks) {
+		const size_t approx = text.size() / chunks.size();
+		size_t begin = 0;
+		for(size_t i = 0; i < chunks.size(); ++i) {
+			size_t end = text.size();
+			if(i + 1u < chunks.size() && begin + approx < text.size()) {
+				const void* eol = memchr(text.data() + begin + approx, '\n', text.size() - begin - approx);
+				end = eol ? size_t(static_cast<const char*>(eol) - text.data()) + 1u : text.size();
+			}
+			chunks[i].text = text.substr(begin, end - begin);
+			begin = end;
+		}
+	}
+
+	static void parse_chunk(Chunk& chunk) {
+		const std::string_view text = chunk.text;
+		// A valid chunk is checked once, lines are checked one by one only to locate an error.
+		const bool is_valid_utf8 = Utf8::validate(text);
+		DictionaryStore& store = *chunk.store;
+		store.reserve(store.size(), store.pool_size() + text.size());
+		size_t pos = 0;
+		while(pos < text.size()) {
+			const auto* eol = static_cast<const char*>(memchr(text.data() + pos, '\n', text.size() - pos));
+			const size_t end = eol ? size_t(eol - text.data()) : text.size();
+			std::string_view line = text.substr(pos, end - pos);
+			pos = end + 1u;
+			++chunk.lines;
+
+			if((not line.empty()) && line.back() == '\r') {
+				line.remove_suffix(1);
+			}
+			if(line.empty() || line[0] == '/') {
+				continue;
+			}
+			Record rec;
+			const bool is_valid = is_valid_utf8 || Utf8::validate(line);
+			if(not (is_valid && rec.read(line) && store.add(rec))) {
+				chunk.errors.push_back(Error{chunk.lines, line});
+			}
+		}
+	}
+
+	static void report(const size_t line, const std::string_view& text) {
+		fprintf(stderr, "Line %zu cannot be parsed : %.*s.\n", line, int(text.size()), text.data());
+	}
+
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include "DictionaryStore.h"
+#include "Hash.h"
+#include "Record.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Applies the edits of the text dictionary to the loaded store.
+ *
+ * The lines are compared by hash : the changed range is what is left between the common
+ * head and the common tail of the old and the new text, the lines of the range which
+ * are not in the old text are parsed, the ones which are not in the new text are removed.
+ * The records of the removed lines are found in the store by the content and
+ * overwritten by the added ones in place, the rest become tombstones or are appended.
+ * So the indices of the untouched records stay valid, whatever order the store is in.
+ */
+class DictionaryReloader {
+public:
+
+	struct Stat {
+		size_t replaced = 0;
+		size_t added = 0;
+		size_t erased = 0;
+	};
+
+private:
+
+	static constexpr uint64_t NOT_RECORD = 0;
+	static constexpr size_t RESYNC_WINDOW = 64;
+
+	using KeyIndex_t = std::pair<uint64_t, uint32_t>;
+
+	// The hash of every line of the current text and the key of its record.
+	std::vector<uint64_t> _lines;
+	std::vector<uint64_t> _keys;
+	// The store slots by the record key, sorted.
+	std::vector<KeyIndex_t> _slots;
+	std::string _scratch;
+
+public:
+
+	/**
+	 * Takes @text as the source of @dic.
+	 */
+	void reset(const std::string_view& text, const DictionaryStore& dic) {
+		_lines.clear();
+		_keys.clear();
+		for_each_line(text, [this](const std::string_view& line) {
+			_lines.push_back(Fnv1a::of(line));
+			_keys.push_back(key_of(line));
+		});
+
+		_slots.clear();
+		_slots.reserve(dic.size());
+		for(size_t idx = 0; idx < dic.size(); ++idx) {
+			if(not dic.is_erased(idx)) {
+				_slots.emplace_back(dic[idx].hash(), static_cast<uint32_t>(idx));
+			}
+		}
+		std::sort(_slots.begin(), _slots.end());
+	}
+
+	/**
+	 * Brings @dic in line with the new @text.
+	 */
+	Stat update(const std::string_view& text, DictionaryStore& dic) {
+		std::vector<uint64_t> lines;
+		std::vector<std::string_view> views;
+		lines.reserve(_lines.size());
+		views.reserve(_lines.size());
+		for_each_line(text, [&lines, &views](const std::string_view& line) {
+			lines.push_back(Fnv1a::of(line));
+			views.push_back(line);
+		});
+
+		size_t head = 0;
+		while(head < lines.size() && head < _lines.size() && lines[head] == _lines[head]) {
+			++head;
+		}
+		size_t tail = 0;
+		while(tail < lines.size() - head && tail < _lines.size() - head
+			&& lines[lines.size() - 1u - tail] == _lines[_lines.size() - 1u - tail]) {
+			++tail;
+		}
+
+		// Within the changed range a line which is still there keeps its record,
+		// the slots of the removed records are reused by the added ones.
+		std::vector<uint64_t> keys(lines.size(), NOT_RECORD);
+		std::copy(_keys.begin(), _keys.begin() + head, keys.begin());
+		std::copy(_keys.end() - tail, _keys.end(), keys.end() - tail);
+		std::vector<uint32_t> added;
+		std::vector<uint32_t> removed;
+
+		// The lines are walked in step, a short run of the changed lines is skipped over.
+		const size_t old_end = _lines.size() - tail;
+		const size_t new_end = lines.size() - tail;
+		size_t old_pos = head;
+		size_t new_pos = head;
+		while(old_pos < old_end && new_pos < new_end) {
+			if(_lines[old_pos] == lines[new_pos]) {
+				keys[new_pos++] = _keys[old_pos++];
+				continue;
+			}
+			size_t skip_old = 0;
+			size_t skip_new = 0;
+			for(size_t dist = 1; dist <= RESYNC_WINDOW && skip_old + skip_new == 0; ++dist) {
+				const bool has_old = (old_pos + dist < old_end);
+				const bool has_new = (new_pos + dist < new_end);
+				if(has_old && _lines[old_pos + dist] == lines[new_pos]) {
+					skip_old = dist;
+				} else if(has_new && _lines[old_pos] == lines[new_pos + dist]) {
+					skip_new = dist;
+				} else if(has_old && has_new && _lines[old_pos + dist] == lines[new_pos + dist]) {
+					skip_old = dist;
+					skip_new = dist;
+				}
+			}
+			if(skip_old + skip_new == 0) {
+				break;
+			}
+			for(; skip_old > 0; --skip_old) {
+				removed.push_back(static_cast<uint32_t>(old_pos++));
+			}
+			for(; skip_new > 0; --skip_new) {
+				added.push_back(static_cast<uint32_t>(new_pos++));
+			}
+		}
+
+		// The rest is reordered too much, the lines are matched by sorting.
+		std::vector<KeyIndex_t> old_lines;
+		std::vector<KeyIndex_t> new_lines;
+		for(; old_pos < old_end; ++old_pos) {
+			old_lines.emplace_back(_lines[old_pos], static_cast<uint32_t>(old_pos));
+		}
+		for(; new_pos < new_end; ++new_pos) {
+			new_lines.emplace_back(lines[new_pos], static_cast<uint32_t>(new_pos));
+		}
+		std::sort(old_lines.begin(), old_lines.end());
+		std::sort(new_lines.begin(), new_lines.end());
+		old_pos = 0;
+		new_pos = 0;
+		while(old_pos < old_lines.size() || new_pos < new_lines.size()) {
+			if(new_pos == new_lines.size() || (old_pos < old_lines.size() && old_lines[old_pos].first < new_lines[new_pos].first)) {
+				removed.push_back(old_lines[old_pos++].second);
+			} else if(old_pos == old_lines.size() || new_lines[new_pos].first < old_lines[old_pos].first) {
+				added.push_back(new_lines[new_pos++].second);
+			} else {
+				keys[new_lines[new_pos++].second] = _keys[old_lines[old_pos++].second];
+			}
+		}
+		std::sort(added.begin(), added.end());
+
+		std::vector<uint32_t> freed;
+		for(const uint32_t idx : removed) {
+			const uint64_t key = _keys[idx];
+			const auto it = std::lower_bound(_slots.begin(), _slots.end(), KeyIndex_t(key, 0));
+			if(key != NOT_RECORD && it != _slots.end() && it->first == key) {
+				freed.push_back(it->second);
+				_slots.erase(it);
+			}
+		}
+
+		Stat stat;
+		std::vector<KeyIndex_t> taken;
+		for(const size_t idx : added) {
+			if(is_comment(views[idx])) {
+				continue;
+			}
+			Record rec;
+			if(parse(views[idx], rec)) {
+				const bool has_slot = stat.replaced < freed.size();
+				const size_t slot = has_slot ? freed[stat.replaced] : dic.size();
+				if(has_slot ? dic.replace(slot, rec) : dic.add(rec)) {
+					keys[idx] = dic[slot].hash();
+					taken.emplace_back(keys[idx], static_cast<uint32_t>(slot));
+					++(has_slot ? stat.replaced : stat.added);
+				}
+			} else {
+				fprintf(stderr, "Line %zu cannot be parsed : %.*s.\n", idx + 1u, int(views[idx].size()), views[idx].data());
+			}
+		}
+		for(size_t idx = stat.replaced; idx < freed.size(); ++idx) {
+			dic.erase(freed[idx]);
+			++stat.erased;
+		}
+
+		std::sort(taken.begin(), taken.end());
+		const size_t middle = _slots.size();
+		_slots.insert(_slots.end(), taken.begin(), taken.end());
+		std::inplace_merge(_slots.begin(), _slots.begin() + middle, _slots.end());
+		_lines = std::move(lines);
+		_keys = std::move(keys);
+		return stat;
+	}
+
+private:
+
+	/**
+	 * Calls fn(line) for every line of @text without the line break.
+	 */
+	template <typename F>
+	static void for_each_line(const std::string_view& text, F&& fn) {
+		size_t pos = 0;
+		while(pos < text.size()) {
+			const auto* eol = static_cast<const char*>(memchr(text.data() + pos, '\n', text.size() - pos));
+			const size_t end = eol ? size_t(eol - text.data()) : text.size();
+			std::string_view line = text.substr(pos, end - pos);
+			pos = end + 1u;
+			if((not line.empty()) && line.back() == '\r') {
+				line.remove_suffix(1);
+			}
+			fn(line);
+		}
+	}
+
+	/**
+	 * The same rules as DictionaryParser has.
+	 */
+	static bool is_comment(const std::string_view& line) {
+		return line.empty() || line[0] == '/';
+	}
+
+	static bool parse(const std::string_view& line, Record& rec) {
+		return Utf8::validate(line) && rec.read(line);
+	}
+
+	/**
+	 * @return The Record::hash() of the line as it is in the store, NOT_RECORD if it is not a record.
+	 */
+	uint64_t key_of(const std::string_view& line) {
+		Record rec;
+		if(is_comment(line) || (not parse(line, rec))) {
+			return NOT_RECORD;
+		}
+		if(not rec.is_raw()) {
+			_scratch.resize(line.size());
+			char* out = _scratch.data();
+			std::string_view* const fields[Record::FIELDS] = {&rec.kanji, &rec.kana, &rec.translation};
+			for(size_t i = 0; i < Record::FIELDS; ++i) {
+				const size_t len = Record::unescape(*fields[i], rec.escaping[i], out);
+				*fields[i] = std::string_view(out, len);
+				out += len;
+			}
+		}
+		return rec.hash();
+	}
+
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "DiceMachine.h"
+#include "DictionaryStore.h"
+#include "Record.h"
+#include "Utf8.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+/**
+ * Uniform sampling of records in one pass over the text dictionary.
+ *
+ * Reservoir sampling with geometric skips (Li's Algorithm L) : only the picked records
+ * are copied, so the memory stays O(k) whatever the size of the dictionary.
+ * Every line is validated before it is counted : a malformed line is reported and is not
+ * a candidate, so the sample is uniform over the valid records wherever the malformed ones are.
+ */
+class DictionarySampler {
+
+	DiceMachine& _dm;
+	const size_t _k;
+	double _w;
+
+public:
+
+	DictionarySampler(DiceMachine& dm, const size_t k) : _dm(dm), _k(k), _w(1.) {}
+
+	struct Stat {
+		size_t candidates = 0;
+		size_t errors = 0;
+	};
+
+	/**
+	 * Fills @out with at most k records of @text chosen uniformly among the record lines.
+	 * @out is not shuffled : the first k records keep the file order until replaced.
+	 */
+	Stat sample(const std::string_view& text, DictionaryStore& out) {
+		return sample(&text, 1u, out);
+	}
+
+	/**
+	 * Samples the records of @count texts as if they were one, a record is tagged
+	 * with the index of its text as the source.
+	 */
+	Stat sample(const std::string_view* texts, const size_t count, DictionaryStore& out) {
+		Stat stat;
+		out.clear();
+		if(_k == 0) {
+			return stat;
+		}
+
+		size_t next_pick = 0;
+		for(size_t source = 0; source < count; ++source) {
+			const std::string_view text = texts[source];
+			const auto tag = static_cast<uint16_t>(source);
+			size_t line_cnt = 0;
+			size_t pos = 0;
+			while(pos < text.size()) {
+				const auto* eol = static_cast<const char*>(memchr(text.data() + pos, '\n', text.size() - pos));
+				const size_t end = eol ? size_t(eol - text.data()) : text.size();
+				std::string_view line = text.substr(pos, end - pos);
+				pos = end + 1u;
+				++line_cnt;
+
+				if((not line.empty()) && line.back() == '\r') {
+					line.remove_suffix(1);
+				}
+				if(line.empty() || line[0] == '/') {
+					continue;
+				}
+
+				Record rec;
+				if(not (Utf8::validate(line) && rec.read(line))) {
+					report(line_cnt, line, stat);
+					continue;
+				}
+
+				const size_t item = stat.candidates++;
+				if(out.size() < _k) {
+					if(add(rec, line_cnt, line, tag, out, stat) && out.size() == _k) {
+						_w = std::exp(std::log(random()) / double(_k));
+						next_pick = item + skip() + 1u;
+					}
+				} else if(item == next_pick) {
+					replace(rec, line_cnt, line, tag, out, stat);
+					_w *= std::exp(std::log(random()) / double(_k));
+					next_pick = item + skip() + 1u;
+				}
+			}
+		}
+		return stat;
+	}
+
+private:
+
+	/**
+	 * @return A number in (0, 1].
+	 */
+	double random() {
+		return 1. - _dm.drand48();
+	}
+
+	/**
+	 * @return The number of candidates to skip before the next pick.
+	 */
+	size_t skip() {
+		const double gap = std::floor(std::log(random()) / std::log1p(-_w));
+		return (gap < 0. || gap >= double(SIZE_MAX / 2u)) ? SIZE_MAX / 2u : size_t(gap);
+	}
+
+	/**
+	 * @return false if @rec exceeds the store limits, it is not a candidate then.
+	 */
+	bool add(const Record& rec, const size_t line_num, const std::string_view& line, const uint16_t source, DictionaryStore& out, Stat& stat) {
+		const bool result = out.add(rec);
+		if(result) {
+			out.begin()[out.size() - 1u].source = source;
+		} else {
+			--stat.candidates;
+			report(line_num, line, stat);
+		}
+		return result;
+	}
+
+	void replace(const Record& rec, const size_t line_num, const std::string_view& line, const uint16_t source, DictionaryStore& out, Stat& stat) {
+		const auto slot = static_cast<size_t>(_dm.uniform(_k));
+		if(out.replace(slot, rec)) {
+			out.begin()[slot].source = source;
+		} else {
+			report(line_num, line, stat);
+		}
+	}
+
+	static void report(const size_t line_num, const std::string_view& line, Stat& stat) {
+		++stat.errors;
+		fprintf(stderr, "Line %zu cannot be parsed : %.*s.\n", line_num, int(line.size()), line.data());
+	}
+
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <sys/stat.h>
+
+/**
+ * Resolves the dictionary arguments into the list of the source files.
+ *
+ * An argument is a file, a directory or a glob pattern. A directory is walked
+ * recursively. The hidden files, the dictionary images and the temporary files are skipped
+ * in a directory and among the matches of a pattern, only a file named as is is taken anyway.
+ * The files of an argument are sorted by name, a file listed twice is taken once.
+ */
+struct DictionarySources {
+
+	/**
+	 * @return false if an argument matches no file.
+	 */
+	static bool expand(const std::vector<std::string>& args, std::vector<std::string>& files) {
+		bool result = true;
+		files.clear();
+		for(const std::string& arg : args) {
+			std::vector<std::string> found;
+			glob_t matches;
+			if(glob(arg.c_str(), GLOB_NOCHECK, nullptr, &matches) == 0) {
+				for(size_t idx = 0; idx < matches.gl_pathc; ++idx) {
+					const std::string path = matches.gl_pathv[idx];
+					if(path == arg || not is_skipped(path)) {
+						collect(path, found);
+					}
+				}
+				globfree(&matches);
+			}
+			std::sort(found.begin(), found.end());
+			if(found.empty()) {
+				result = false;
+				fprintf(stderr, "Dictionary file '%s' is not available for reading.\n", arg.c_str());
+			}
+			for(auto& file : found) {
+				if(std::find(files.begin(), files.end(), file) == files.end()) {
+					files.push_back(std::move(file));
+				}
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * @return true if the path or the file name of @file matches any of @patterns.
+	 */
+	static bool matches(const std::string& file, const std::vector<std::string>& patterns) {
+		const size_t slash = file.rfind('/');
+		const char* name = file.c_str() + (slash == std::string::npos ? 0 : slash + 1u);
+		for(const std::string& pattern : patterns) {
+			if(fnmatch(pattern.c_str(), file.c_str(), 0) == 0 || fnmatch(pattern.c_str(), name, 0) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+
+	static void collect(const std::string& path, std::vector<std::string>& found) {
+		struct stat st;
+		if(stat(path.c_str(), &st) != 0) {
+			return;
+		}
+		if(S_ISREG(st.st_mode)) {
+			found.push_back(path);
+		} else if(S_ISDIR(st.st_mode)) {
+			DIR* dir = opendir(path.c_str());
+			if(dir == nullptr) {
+				return;
+			}
+			const std::string prefix = (path.back() == '/') ? path : path + '/';
+			for(const dirent* ent = readdir(dir); ent != nullptr; ent = readdir(dir)) {
+				const std::string name = ent->d_name;
+				if(name.empty() || is_skipped(name)) {
+					continue;
+				}
+				collect(prefix + name, found);
+			}
+			closedir(dir);
+		}
+	}
+
+	/**
+	 * @return true if the file name of @path is hidden, an image or a temporary file.
+	 */
+	static bool is_skipped(const std::string& path) {
+		std::string_view name(path);
+		while(name.size() > 1u && name.back() == '/') {
+			name.remove_suffix(1);
+		}
+		const size_t slash = name.rfind('/');
+		name.remove_prefix(slash == std::string_view::npos ? 0 : slash + 1u);
+		return (not name.empty()) && (name[0] == '.' || ends_with(name, ".bin") || ends_with(name, ".tmp"));
+	}
+
+	static bool ends_with(const std::string_view& str, const std::string_view& sfx) {
+		return str.size() >= sfx.size() && str.compare(str.size() - sfx.size(), sfx.size(), sfx) == 0;
+	}
+
+};
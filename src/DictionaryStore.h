@@ -0,0 +1,313 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Record.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Struct-of-arrays dictionary storage.
+ * The fields of all the records live in one UTF-8 arena, a record itself is
+ * a fixed-size index entry, so reordering the dictionary moves 12 bytes per record.
+ * The arena and the entries are either owned or borrowed from a mapped dictionary image.
+ */
+class DictionaryStore {
+public:
+
+	struct Entry {
+		uint32_t offset;
+		uint16_t kanji_len;
+		uint16_t kana_len;
+		uint16_t translation_len;
+		// The index of the source file.
+		uint16_t source;
+	};
+
+	static_assert(sizeof(Entry) == 12u, "Unexpected Entry padding.");
+
+private:
+
+	static constexpr size_t FIELD_MAX = std::numeric_limits<uint16_t>::max();
+	static constexpr size_t POOL_MAX = std::numeric_limits<uint32_t>::max();
+
+	std::string _pool_buf;
+	std::vector<Entry> _entries_buf;
+	MappedFile _image;
+
+	const char* _pool;
+	size_t _pool_size;
+	Entry* _entries;
+	size_t _size;
+
+public:
+
+	DictionaryStore() : _pool(nullptr), _pool_size(0), _entries(nullptr), _size(0) {}
+
+	DictionaryStore(const DictionaryStore&) = delete;
+	DictionaryStore& operator=(const DictionaryStore&) = delete;
+
+	/**
+	 * Copies the fields into the arena, escaped fields are unescaped on the way.
+	 * @return false if a field or the arena exceeds the index limits.
+	 */
+	bool add(const Record& rec) {
+		const size_t len = rec.kanji.size() + rec.kana.size() + rec.translation.size();
+		bool result = (_pool_size + len <= POOL_MAX);
+		if(result) {
+			own();
+			const size_t base = _pool_buf.size();
+			size_t field_len[Record::FIELDS];
+			if(rec.is_raw()) {
+				_pool_buf.append(rec.kanji);
+				_pool_buf.append(rec.kana);
+				_pool_buf.append(rec.translation);
+				field_len[0] = rec.kanji.size();
+				field_len[1] = rec.kana.size();
+				field_len[2] = rec.translation.size();
+			} else {
+				_pool_buf.resize(base + len);
+				char* out = _pool_buf.data() + base;
+				const std::string_view fields[Record::FIELDS] = {rec.kanji, rec.kana, rec.translation};
+				for(size_t i = 0; i < Record::FIELDS; ++i) {
+					if(rec.escaping[i] == Record::RAW) {
+						memcpy(out, fields[i].data(), fields[i].size());
+						field_len[i] = fields[i].size();
+					} else {
+						field_len[i] = Record::unescape(fields[i], rec.escaping[i], out);
+					}
+					out += field_len[i];
+				}
+				_pool_buf.resize(size_t(out - _pool_buf.data()));
+			}
+
+			result = (field_len[0] <= FIELD_MAX) && (field_len[1] <= FIELD_MAX) && (field_len[2] <= FIELD_MAX);
+			if(result) {
+				Entry entry;
+				entry.offset = static_cast<uint32_t>(base);
+				entry.kanji_len = static_cast<uint16_t>(field_len[0]);
+				entry.kana_len = static_cast<uint16_t>(field_len[1]);
+				entry.translation_len = static_cast<uint16_t>(field_len[2]);
+				entry.source = 0;
+				_entries_buf.push_back(entry);
+			} else {
+				_pool_buf.resize(base);
+			}
+			sync();
+		}
+		return result;
+	}
+
+	/**
+	 * Overwrites the record @idx with @rec.
+	 * The fields are appended to the arena, the previous ones are not reclaimed.
+	 */
+	bool replace(const size_t idx, const Record& rec) {
+		const bool result = add(rec);
+		if(result) {
+			_entries_buf[idx] = _entries_buf.back();
+			_entries_buf.pop_back();
+			sync();
+		}
+		return result;
+	}
+
+	/**
+	 * Drops the records equal to a preceding one, the order of the rest is kept.
+	 * @return The number of the records dropped.
+	 */
+	size_t deduplicate() {
+		std::vector<std::pair<uint64_t, uint32_t>> keys;
+		keys.reserve(_size);
+		for(size_t idx = 0; idx < _size; ++idx) {
+			keys.emplace_back(record(_entries[idx]).hash(), static_cast<uint32_t>(idx));
+		}
+		std::sort(keys.begin(), keys.end());
+
+		std::vector<bool> is_dup(_size, false);
+		size_t dups = 0;
+		for(size_t first = 0; first < keys.size();) {
+			size_t last = first + 1u;
+			while(last < keys.size() && keys[last].first == keys[first].first) {
+				++last;
+			}
+			// A run of the same hash, each record is compared with the preceding kept ones.
+			for(size_t cur = first + 1u; cur < last; ++cur) {
+				const Record rec = record(_entries[keys[cur].second]);
+				for(size_t prev = first; prev < cur; ++prev) {
+					if((not is_dup[keys[prev].second]) && rec == record(_entries[keys[prev].second])) {
+						is_dup[keys[cur].second] = true;
+						++dups;
+						break;
+					}
+				}
+			}
+			first = last;
+		}
+
+		if(dups > 0) {
+			own();
+			size_t out = 0;
+			for(size_t idx = 0; idx < _entries_buf.size(); ++idx) {
+				if(not is_dup[idx]) {
+					_entries_buf[out++] = _entries_buf[idx];
+				}
+			}
+			_entries_buf.resize(out);
+			sync();
+		}
+		return dups;
+	}
+
+	/**
+	 * Turns the record @idx into a tombstone : all the fields are empty, the indices are kept.
+	 */
+	void erase(const size_t idx) {
+		own();
+		_entries_buf[idx] = Entry{0, 0, 0, 0, 0};
+		sync();
+	}
+
+	/**
+	 * A record always has the kana, a tombstone has not.
+	 */
+	bool is_erased(const size_t idx) const {
+		return _entries[idx].kana_len == 0;
+	}
+
+	/**
+	 * Appends all the records of @other, their relative order is kept.
+	 * @return false if the arena would exceed the index limits, nothing is appended in that case.
+	 */
+	bool append(const DictionaryStore& other) {
+		const bool result = (_pool_size + other._pool_size <= POOL_MAX);
+		if(result) {
+			own();
+			const auto shift = static_cast<uint32_t>(_pool_buf.size());
+			_pool_buf.append(other._pool, other._pool_size);
+			_entries_buf.reserve(_entries_buf.size() + other._size);
+			for(const auto& entry : other) {
+				_entries_buf.push_back(entry);
+				_entries_buf.back().offset += shift;
+			}
+			sync();
+		}
+		return result;
+	}
+
+	/**
+	 * Borrows the arena and the entries from a mapped image.
+	 * The entries must lie in a private writable mapping, they are reordered in place.
+	 */
+	void attach(MappedFile&& image, const char* pool, const size_t pool_size, Entry* entries, const size_t size) {
+		clear();
+		_image = std::move(image);
+		_pool = pool;
+		_pool_size = pool_size;
+		_entries = entries;
+		_size = size;
+	}
+
+	Record operator[](const size_t idx) const {
+		return record(_entries[idx]);
+	}
+
+	Record record(const Entry& entry) const {
+		const char* ptr = _pool + entry.offset;
+		Record rec;
+		rec.kanji = std::string_view(ptr, entry.kanji_len);
+		ptr += entry.kanji_len;
+		rec.kana = std::string_view(ptr, entry.kana_len);
+		ptr += entry.kana_len;
+		rec.translation = std::string_view(ptr, entry.translation_len);
+		return rec;
+	}
+
+	void reserve(const size_t records, const size_t pool_bytes) {
+		own();
+		_entries_buf.reserve(records);
+		_pool_buf.reserve(pool_bytes);
+		sync();
+	}
+
+	void clear() {
+		_image.close();
+		_entries_buf.clear();
+		_pool_buf.clear();
+		sync();
+	}
+
+	/**
+	 * Releases the capacity reserved but not used while loading.
+	 */
+	void shrink_to_fit() {
+		if(not is_mapped()) {
+			_entries_buf.shrink_to_fit();
+			_pool_buf.shrink_to_fit();
+			sync();
+		}
+	}
+
+	Entry* begin() {
+		return _entries;
+	}
+
+	Entry* end() {
+		return _entries + _size;
+	}
+
+	const Entry* begin() const {
+		return _entries;
+	}
+
+	const Entry* end() const {
+		return _entries + _size;
+	}
+
+	size_t size() const {
+		return _size;
+	}
+
+	bool empty() const {
+		return _size == 0;
+	}
+
+	std::string_view pool() const {
+		return std::string_view(_pool, _pool_size);
+	}
+
+	size_t pool_size() const {
+		return _pool_size;
+	}
+
+	bool is_mapped() const {
+		return _image.size() > 0;
+	}
+
+private:
+
+	/**
+	 * Copies the borrowed image into the owned buffers before a modification.
+	 */
+	void own() {
+		if(is_mapped()) {
+			_pool_buf.assign(_pool, _pool_size);
+			_entries_buf.assign(_entries, _entries + _size);
+			_image.close();
+			sync();
+		}
+	}
+
+	void sync() {
+		_pool = _pool_buf.data();
+		_pool_size = _pool_buf.size();
+		_entries = _entries_buf.data();
+		_size = _entries_buf.size();
+	}
+
+};
@@ -7,6 +7,7 @@
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 
 class FieldReader {
 
@@ -70,6 +71,19 @@ public:
 		return result;
 	}
 
+	/**
+	 * Appends an item, so a repeated option collects all of its values.
+	 */
+	template <typename V>
+	static bool read(std::vector<V>& value, const std::string_view& str) {
+		V item;
+		const bool result = read(item, str);
+		if(result) {
+			value.push_back(std::move(item));
+		}
+		return result;
+	}
+
 	// -----------------------------------------------------------------
 	// Basic JTF types.
 	// -----------------------------------------------------------------
@@ -85,18 +99,9 @@ public:
 
 private:
 
-	// TODO: linear time complexity
 	template <typename Enum, typename Converter, bool Pedantic>
 	static Enum as_enum(EnumField<Enum, Converter, Pedantic>&, const std::string_view& str) {
-		auto result = Enum::__SIZE;
-		for(EnumBase_t i = 0; i < static_cast<EnumBase_t>(Enum::__SIZE); ++i) {
-			const auto val = static_cast<Enum>(i);
-			if(str == EnumField<Enum,Converter>::to_cstr(val)) {
-				result = val;
-				break;
-			}
-		}
-		return result;
+		return EnumField<Enum, Converter, Pedantic>::from_cstr(str);
 	}
 
 };
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdio>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 struct FieldWriter {
 
@@ -21,9 +23,58 @@ struct FieldWriter {
 		buf.append(value);
 	}
 
+	/**
+	 * The items separated by ','.
+	 */
+	template <typename V>
+	static void write(std::string& buf, const std::vector<V>& value) {
+		for(size_t idx = 0; idx < value.size(); ++idx) {
+			if(idx > 0) {
+				buf.push_back(',');
+			}
+			write(buf, value[idx]);
+		}
+	}
+
 	template <typename V, std::enable_if_t<(std::is_class_v<V>), int> = 0>
 	static void write(std::string& buf, const V& value) {
 		value.write(buf);
 	}
 
+	// -----------------------------------------------------------------
+	// The same straight into a stream, without a buffer.
+	// -----------------------------------------------------------------
+	template <typename V, std::enable_if_t<(std::is_integral_v<V> && std::is_signed_v<V>), int> = 0>
+	static void write(FILE* out, const V& value) {
+		fprintf(out, "%lld", static_cast<long long>(value));
+	}
+
+	template <typename V, std::enable_if_t<(std::is_integral_v<V> && std::is_unsigned_v<V>), int> = 0>
+	static void write(FILE* out, const V& value) {
+		fprintf(out, "%llu", static_cast<unsigned long long>(value));
+	}
+
+	static void write(FILE* out, const std::string& value) {
+		fwrite(value.data(), 1, value.size(), out);
+	}
+
+	static void write(FILE* out, const char* value) {
+		fputs(value, out);
+	}
+
+	template <typename V>
+	static void write(FILE* out, const std::vector<V>& value) {
+		for(size_t idx = 0; idx < value.size(); ++idx) {
+			if(idx > 0) {
+				fputc(',', out);
+			}
+			write(out, value[idx]);
+		}
+	}
+
+	template <typename V, std::enable_if_t<(std::is_class_v<V>), int> = 0>
+	static void write(FILE* out, const V& value) {
+		value.write(out);
+	}
+
 };
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+ * Notifies of the changes of a file through inotify without blocking.
+ *
+ * The directory is watched rather than the file itself, so the file may be
+ * replaced by a rename as the editors do on saving.
+ */
+class FileWatcher {
+
+	static constexpr uint32_t EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+	int _fd;
+	std::string _name;
+
+public:
+
+	FileWatcher() : _fd(-1) {}
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	~FileWatcher() {
+		close();
+	}
+
+	bool open(const std::string& path) {
+		close();
+		const size_t slash = path.rfind('/');
+		const std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+		_name = (slash == std::string::npos) ? path : path.substr(slash + 1u);
+		_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		bool result = (_fd >= 0) && (inotify_add_watch(_fd, dir.c_str(), EVENTS) >= 0);
+		if(not result) {
+			close();
+		}
+		return result;
+	}
+
+	void close() {
+		if(_fd >= 0) {
+			::close(_fd);
+			_fd = -1;
+		}
+	}
+
+	/**
+	 * Drains the pending events.
+	 * @return true if the file has been written or replaced since the previous call.
+	 */
+	bool changed() {
+		bool result = false;
+		alignas(struct inotify_event) char buf[4096];
+		while(_fd >= 0) {
+			const ssize_t len = read(_fd, buf, sizeof(buf));
+			if(len <= 0) {
+				break;
+			}
+			for(ssize_t pos = 0; pos < len;) {
+				const auto* event = reinterpret_cast<const struct inotify_event*>(buf + pos);
+				if(event->len > 0 && _name == event->name) {
+					result = true;
+				}
+				pos += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		return result;
+	}
+
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * 64-bit FNV-1a.
+ * Stable across runs and platforms, used for persistent keys and checksums.
+ */
+struct Fnv1a {
+
+	static constexpr uint64_t BASIS = 14695981039346656037ull;
+	static constexpr uint64_t PRIME = 1099511628211ull;
+
+	uint64_t value = BASIS;
+
+	void mix(const void* data, const size_t size) {
+		const auto* ptr = static_cast<const uint8_t*>(data);
+		for(size_t i = 0; i < size; ++i) {
+			value ^= ptr[i];
+			value *= PRIME;
+		}
+	}
+
+	void mix(const std::string_view& str) {
+		mix(str.data(), str.size());
+	}
+
+	static uint64_t of(const std::string_view& str) {
+		Fnv1a hash;
+		hash.mix(str);
+		return hash.value;
+	}
+
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "DictionaryStore.h"
+#include "Hash.h"
+#include "Parallel.h"
+#include "Record.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * Exact lookup of the records by the kanji, the kana or the translation.
+ *
+ * Every field has its own open-addressing table (linear probing, load factor up to 1/2)
+ * of the distinct values, a slot holds the hash and the first record of the value.
+ * The homographs are chained in the index order through a per-record link array.
+ * The fields are indexed in parallel.
+ */
+class HashIndex {
+public:
+
+	enum Field : unsigned {
+		KANJI,
+		KANA,
+		TRANSLATION,
+		FIELDS
+	};
+
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+
+	struct Slot {
+		uint64_t hash;
+		uint32_t head;
+	};
+
+	struct Table {
+		std::vector<Slot> slots;
+		std::vector<uint32_t> next;
+		size_t mask = 0;
+	};
+
+	const DictionaryStore* _dic;
+	Table _tables[FIELDS];
+
+public:
+
+	HashIndex() : _dic(nullptr) {}
+
+	HashIndex(const HashIndex&) = delete;
+	HashIndex& operator=(const HashIndex&) = delete;
+
+	/**
+	 * Indexes @dic, which must outlive the index and stay unchanged.
+	 */
+	void build(const DictionaryStore& dic, const unsigned threads) {
+		_dic = &dic;
+		Parallel::for_each(FIELDS, Parallel::concurrency(threads), [this](const size_t field) {
+			build(static_cast<Field>(field));
+		});
+	}
+
+	/**
+	 * @return The first record having @key in @field, NONE if there is no such a record.
+	 */
+	uint32_t find(const Field field, const std::string_view& key) const {
+		const Table& table = _tables[field];
+		if(table.slots.empty() || key.empty()) {
+			return NONE;
+		}
+		const uint64_t hash = Fnv1a::of(key);
+		for(size_t pos = hash & table.mask;; pos = (pos + 1u) & table.mask) {
+			const Slot& slot = table.slots[pos];
+			if(slot.head == NONE) {
+				return NONE;
+			}
+			if(slot.hash == hash && value(slot.head, field) == key) {
+				return slot.head;
+			}
+		}
+	}
+
+	/**
+	 * @return The next record having the same @field value as @record, NONE after the last one.
+	 */
+	uint32_t next(const Field field, const uint32_t record) const {
+		return _tables[field].next[record];
+	}
+
+	static std::string_view value(const Record& rec, const Field field) {
+		switch(field) {
+			case KANJI: return rec.kanji;
+			case KANA: return rec.kana;
+			case TRANSLATION: return rec.translation;
+			default: return std::string_view();
+		}
+	}
+
+	static const char* to_cstr(const Field field) {
+		switch(field) {
+			case KANJI: return "kanji";
+			case KANA: return "kana";
+			case TRANSLATION: return "translation";
+			default: return "[UNKNOWN]";
+		}
+	}
+
+private:
+
+	std::string_view value(const uint32_t record, const Field field) const {
+		return value((*_dic)[record], field);
+	}
+
+	void build(const Field field) {
+		Table& table = _tables[field];
+		const size_t size = _dic->size();
+		size_t capacity = 16;
+		while(capacity < size * 2u) {
+			capacity <<= 1u;
+		}
+		table.mask = capacity - 1u;
+		table.slots.assign(capacity, Slot{0, NONE});
+		table.next.assign(size, NONE);
+
+		// Backwards, so a chain gets the records in the index order.
+		for(size_t idx = size; idx-- > 0;) {
+			const std::string_view key = value(static_cast<uint32_t>(idx), field);
+			if(key.empty()) {
+				continue;
+			}
+			const uint64_t hash = Fnv1a::of(key);
+			size_t pos = hash & table.mask;
+			while(table.slots[pos].head != NONE
+				&& (table.slots[pos].hash != hash || value(table.slots[pos].head, field) != key)) {
+				pos = (pos + 1u) & table.mask;
+			}
+			Slot& slot = table.slots[pos];
+			table.next[idx] = slot.head;
+			slot.hash = hash;
+			slot.head = static_cast<uint32_t>(idx);
+		}
+	}
+
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "CodePointMap.h"
+#include "MappedFile.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+/**
+ * Replaces the characters which look like katakana with the katakana :
+ * the kanji and the radicals (力, ⼒ -> カ), the hiragana (へ -> ヘ), the dashes (―, ─ -> ー).
+ *
+ * The built-in table is generated at compile time, a mapping file of
+ * `<from> <to>` lines extends it, '#' starts a comment line.
+ */
+class KatakanaFilter {
+
+	using Table_t = CodePointMap<24>;
+
+	static constexpr char COMMENT = '#';
+
+	Table_t _table;
+
+public:
+
+	KatakanaFilter() : _table(DEFAULT) {}
+
+	/**
+	 * Adds the mappings of the file @path to the table.
+	 * @return false if the file is not available or has malformed lines.
+	 */
+	bool load(const char* path) {
+		MappedFile file;
+		if(not file.open(path)) {
+			fprintf(stderr, "Katakana mapping file '%s' is not available for reading.\n", path);
+			return false;
+		}
+
+		bool result = true;
+		std::u32string line_u32;
+		const std::string_view text = file.view();
+		size_t line_no = 0;
+		for(size_t pos = 0; pos < text.size();) {
+			const size_t end = std::min(text.find('\n', pos), text.size());
+			const std::string_view line = text.substr(pos, end - pos);
+			pos = end + 1u;
+			++line_no;
+
+			if(line.empty() || line.front() == COMMENT) {
+				continue;
+			}
+			char32_t pair[2];
+			size_t cnt = 0;
+			bool ok = Utf8::decode(line, line_u32);
+			for(const char32_t ch : line_u32) {
+				if(ch == U' ' || ch == U'\t' || ch == U'\r') {
+					continue;
+				}
+				ok = ok && (cnt < 2);
+				if(ok) {
+					pair[cnt++] = ch;
+				}
+			}
+			ok = ok && (cnt == 2) && _table.set(pair[0], pair[1]);
+			if(not ok) {
+				result = false;
+				fprintf(stderr, "Line %zu of '%s' cannot be parsed : %.*s.\n", line_no, path, int(line.size()), line.data());
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Filters @text in place, ASCII is passed through without a lookup.
+	 */
+	void apply(std::u32string& text) const {
+		for(char32_t& ch : text) {
+			if(ch >= 0x80) {
+				ch = _table(ch);
+			}
+		}
+	}
+
+private:
+
+	static constexpr Table_t build() {
+		Table_t table;
+		constexpr char32_t LOOK_ALIKES[][2] = {
+			// Kanji.
+			{U'一', U'ー'}, {U'二', U'ニ'}, {U'八', U'ハ'}, {U'力', U'カ'}, {U'卜', U'ト'},
+			{U'口', U'ロ'}, {U'夕', U'タ'}, {U'工', U'エ'}, {U'匚', U'コ'},
+			// Kangxi radicals.
+			{U'⼀', U'ー'}, {U'⼆', U'ニ'}, {U'⼋', U'ハ'}, {U'⼒', U'カ'}, {U'⼘', U'ト'},
+			{U'⼝', U'ロ'}, {U'⼣', U'タ'}, {U'⼯', U'エ'}, {U'⼖', U'コ'},
+			// Hiragana which are the same as katakana.
+			{U'へ', U'ヘ'}, {U'べ', U'ベ'}, {U'ぺ', U'ペ'},
+			// Dashes, minus signs and lines.
+			{U'‐', U'ー'}, {U'‑', U'ー'}, {U'‒', U'ー'}, {U'–', U'ー'}, {U'—', U'ー'}, {U'―', U'ー'},
+			{U'−', U'ー'}, {U'─', U'ー'}, {U'━', U'ー'}, {U'－', U'ー'}, {U'ｰ', U'ー'}
+		};
+		for(const auto& pair : LOOK_ALIKES) {
+			table.set(pair[0], pair[1]);
+		}
+		return table;
+	}
+
+	static const Table_t DEFAULT;
+
+};
+
+inline constexpr KatakanaFilter::Table_t KatakanaFilter::DEFAULT = KatakanaFilter::build();
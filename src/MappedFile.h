@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Private memory mapping of a whole file.
+ * An empty file is mapped as an empty view.
+ */
+class MappedFile {
+	char* _data;
+	size_t _size;
+
+public:
+
+	MappedFile() : _data(nullptr), _size(0) {}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) noexcept : _data(other._data), _size(other._size) {
+		other._data = nullptr;
+		other._size = 0;
+	}
+
+	MappedFile& operator=(MappedFile&& other) noexcept {
+		if(this != &other) {
+			close();
+			std::swap(_data, other._data);
+			std::swap(_size, other._size);
+		}
+		return *this;
+	}
+
+	~MappedFile() {
+		close();
+	}
+
+	/**
+	 * @param path - file to map.
+	 * @param copy_on_write - the pages may be modified, the changes never reach the file.
+	 * @return true if the whole file is mapped.
+	 */
+	bool open(const char* path, const bool copy_on_write = false) {
+		close();
+		bool result = false;
+		const int fd = ::open(path, O_RDONLY);
+		if(fd >= 0) {
+			struct stat st;
+			if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+				_size = static_cast<size_t>(st.st_size);
+				if(_size > 0) {
+					const int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+					void* addr = mmap(nullptr, _size, prot, MAP_PRIVATE, fd, 0);
+					if(addr != MAP_FAILED) {
+						madvise(addr, _size, copy_on_write ? MADV_NORMAL : MADV_SEQUENTIAL);
+						_data = static_cast<char*>(addr);
+						result = true;
+					} else {
+						_size = 0;
+					}
+				} else {
+					result = true;
+				}
+			}
+			::close(fd);
+		}
+		return result;
+	}
+
+	void close() {
+		if(_data) {
+			munmap(_data, _size);
+		}
+		_data = nullptr;
+		_size = 0;
+	}
+
+	std::string_view view() const {
+		return std::string_view(_data, _size);
+	}
+
+	char* data() {
+		return _data;
+	}
+
+	size_t size() const {
+		return _size;
+	}
+
+};
@@ -0,0 +1,629 @@
+#pragma once
+
+#include "NihongoNoTangoCli.h"
+#include "AnswerMatcher.h"
+#include "AudioPlayer.h"
+#include "BatchGrader.h"
+#include "CompressedInput.h"
+#include "DiceMachine.h"
+#include "DictionaryImage.h"
+#include "DictionaryParser.h"
+#include "DictionaryReloader.h"
+#include "DictionarySampler.h"
+#include "DictionarySources.h"
+#include "DictionaryStore.h"
+#include "FileWatcher.h"
+#include "HashIndex.h"
+#include "KatakanaFilter.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "ReviewScheduler.h"
+#include "Stats.h"
+#include "SuffixIndex.h"
+#include "TermWriter.h"
+#include "Utf8.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <string>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+
+#include <sys/stat.h>
+
+class NihongoNoTango {
+
+	using String_t = std::u32string;
+
+	using Buffer_t = DictionaryStore;
+
+	const NihongoNoTangoCli _cli;
+	DiceMachine _dm;
+	// Before _audio, its worker reports into the stats until it is joined.
+	Stats _stats;
+	Buffer_t _dic;
+	ReviewScheduler _review;
+	std::vector<std::string> _sources;
+	KatakanaFilter _filter;
+	HashIndex _index;
+	SuffixIndex _suffixes;
+	FileWatcher _watcher;
+	DictionaryReloader _reloader;
+	std::unique_ptr<AudioPlayer> _audio;
+
+	static constexpr size_t AUDIO_PREFETCH = 3;
+	static constexpr size_t SOURCES_MAX = size_t(std::numeric_limits<uint16_t>::max()) + 1u;
+
+public:
+	NihongoNoTango(const NihongoNoTangoCli& cli) :
+		_cli(cli), _dm(cli.seed.presented() ? cli.seed.value() : uint64_t(time(nullptr))), _stats(cli.stats.presented()) {}
+
+	/**
+	 * Maps the precompiled image of the dictionary if it is up to date,
+	 * otherwise parses the text dictionary.
+	 * Several dictionary files are loaded on the worker threads and merged in the argument order,
+	 * the records repeated across the files are kept once.
+	 * A single file is loaded as it is, its image and suffix array index the records by the position.
+	 * In the streaming mode only the records of the session are kept.
+	 */
+	int load() {
+		int err = expand_sources();
+		if(err == EXIT_SUCCESS && _cli.reload.presented() && _sources.size() > 1u) {
+			err = EXIT_FAILURE;
+			fprintf(stderr, "Reloading needs a single dictionary file, %zu are given.\n", _sources.size());
+		}
+		// Before any of the load paths, each of them applies the map.
+		if(err == EXIT_SUCCESS && _cli.katakana_map.presented() && (not _filter.load(_cli.katakana_map.value().c_str()))) {
+			err = EXIT_FAILURE;
+		}
+		if(err == EXIT_SUCCESS && _cli.stream_sample.presented()) {
+			return load_sample();
+		}
+
+		if(err == EXIT_SUCCESS && _sources.size() == 1u) {
+			err = load_file(_sources.front(), _dic, &_suffixes, _cli.jobs.value());
+			if(err == EXIT_SUCCESS) {
+				printf("%zu lines loaded.\n", _dic.size());
+			}
+		} else if(err == EXIT_SUCCESS) {
+			err = load_files();
+		}
+		if(err == EXIT_SUCCESS) {
+			err = load_review();
+		}
+		return err;
+	}
+
+	/**
+	 * Parses every text dictionary and writes its image with the suffix array next to it.
+	 */
+	int compile() {
+		int err = expand_sources();
+		for(size_t idx = 0; err == EXIT_SUCCESS && idx < _sources.size(); ++idx) {
+			err = compile(_sources[idx]);
+		}
+		return err;
+	}
+
+	/**
+	 * Grades the answers of the input file, the results go to the standard output.
+	 */
+	int grade() {
+		const std::string& path = _cli.input_file.value();
+		const bool is_stdin = (path == "-");
+		MappedFile file;
+		std::string piped;
+		if(is_stdin) {
+			read_all(stdin, piped);
+		} else if(not file.open(path.c_str())) {
+			fprintf(stderr, "Answers file '%s' is not available for reading.\n", path.c_str());
+			return EXIT_FAILURE;
+		}
+
+		build_index();
+		const AnswerMatcher matcher = make_matcher();
+		const BatchGrader grader(_dic, _index, matcher, _cli.katakana_filter.presented() ? &_filter : nullptr);
+		const auto stat = grader.grade(is_stdin ? std::string_view(piped) : file.view(), stdout, _cli.jobs.value(),
+			[this](const Record& rec) { return build_reference(rec); });
+
+		const size_t correct = stat.verdicts[BatchGrader::CORRECT];
+		printf("Graded : %zu. Correct : %zu (%.2f%%). Wrong : %zu. Unknown : %zu. Malformed : %zu.\n",
+			stat.items, correct, stat.items ? correct * 100. / stat.items : 0.,
+			stat.verdicts[BatchGrader::WRONG], stat.verdicts[BatchGrader::UNKNOWN], stat.verdicts[BatchGrader::MALFORMED]);
+		return EXIT_SUCCESS;
+	}
+
+	/**
+	 * Prints the records having the query in any of the fields.
+	 */
+	int lookup() {
+		build_index();
+		const std::string& key = _cli.query.value();
+		std::vector<uint32_t> found;
+		for(unsigned field = 0; field < HashIndex::FIELDS; ++field) {
+			const auto fld = static_cast<HashIndex::Field>(field);
+			for(uint32_t idx = _index.find(fld, key); idx != HashIndex::NONE; idx = _index.next(fld, idx)) {
+				if(std::find(found.begin(), found.end(), idx) != found.end()) {
+					continue;
+				}
+				found.push_back(idx);
+				const Record rec = _dic[idx];
+				printf("%s\t%.*s;%.*s;%.*s\n", HashIndex::to_cstr(fld),
+					int(rec.kanji.size()), rec.kanji.data(),
+					int(rec.kana.size()), rec.kana.data(),
+					int(rec.translation.size()), rec.translation.data());
+			}
+		}
+		printf("%zu records found.\n", found.size());
+		return found.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	/**
+	 * Prints the records containing the query, the suffix array is built unless it comes with the image.
+	 */
+	int search() {
+		if(_suffixes.empty()) {
+			build_suffixes();
+		}
+		std::vector<uint32_t> found;
+		_suffixes.find(_cli.query.value(), found);
+		for(const uint32_t idx : found) {
+			const Record rec = _dic[idx];
+			printf("%.*s;%.*s;%.*s\n",
+				int(rec.kanji.size()), rec.kanji.data(),
+				int(rec.kana.size()), rec.kana.data(),
+				int(rec.translation.size()), rec.translation.data());
+		}
+		printf("%zu records found.\n", found.size());
+		return found.empty() ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	/**
+	 * Prints the statistics to stderr if they are asked for.
+	 */
+	void print_stats() const {
+		if(_stats.enabled()) {
+			fflush(stdout);
+			_stats.print(stderr, _cli.stats.value().get() == NihongoNoTangoCli::EnumStats::JSON);
+		}
+	}
+
+	void build_question(const Record& rec, TermWriter& question) const {
+		if(_cli.show_kanji.presented() && (not rec.kanji.empty())) {
+			question.append(rec.kanji).append(' ');
+		}
+
+		if(_cli.show_kana.presented()) {
+			question.append(rec.kana).append(' ');
+		}
+
+		if(_cli.show_translation.presented()) {
+			question.append(rec.translation).append(' ');
+		}
+	}
+
+	std::string_view build_reference(const Record& rec) const {
+		switch(_cli.answer.value().get()) {
+			case NihongoNoTangoCli::EnumAnswer::KANA: return rec.kana;
+			case NihongoNoTangoCli::EnumAnswer::KANJI: return rec.kanji;
+			case NihongoNoTangoCli::EnumAnswer::TRANSLATION: return rec.translation;
+			default: assert(false); break;
+		}
+		return std::string_view();
+	}
+
+	/**
+	 * Loads the dictionary, then runs @Method on it.
+	 */
+	template <int (NihongoNoTango::*Method)()>
+	int loaded() {
+		int err = load();
+		if(err == EXIT_SUCCESS) {
+			err = (this->*Method)();
+		}
+		return err;
+	}
+
+	int run() {
+		auto tm_before = time(nullptr);
+
+		unsigned cnt_total = 0;
+		unsigned cnt_mistakes = 0;
+
+		const bool is_test = (_cli.action.action().value == NihongoNoTangoCli::EnumMethod::TEST);
+		const std::vector<size_t> session = select_session();
+		if(_cli.play_audio.presented()) {
+			_audio = std::make_unique<AudioPlayer>(_cli.audio_cmd.value(), _cli.audio_player.value(), _stats);
+		}
+
+		if(_cli.reload.presented()) {
+			watch();
+		}
+		AnswerMatcher matcher = make_matcher();
+		// Every prompt and every correction is one write.
+		TermWriter out(STDOUT_FILENO);
+		String_t answer;
+		String_t reference_u32;
+
+		for(size_t round = 0; round < session.size(); ++round) {
+			reload();
+			if(_dic.is_erased(session[round])) {
+				continue;
+			}
+			const Record item = _dic[session[round]];
+			unsigned item_mistakes = 0;
+
+			build_question(item, out);
+			out.flush();
+			if(_audio) {
+				say(item);
+				// Synthesizes the next questions while this one is being answered.
+				for(size_t next = round + 1u; next < std::min(session.size(), round + 1u + AUDIO_PREFETCH); ++next) {
+					if(not _dic.is_erased(session[next])) {
+						_audio->prefetch(speech(_dic[session[next]]));
+					}
+				}
+			}
+
+			const auto shown = _stats.now();
+			read_line(stdin, answer, true);
+			_stats.record(Stats::RESPONSE, shown);
+
+			if(is_test) {
+				const std::string_view reference = build_reference(item);
+				Utf8::decode(reference, reference_u32);
+				filter(reference_u32);
+				filter(answer);
+
+				while(not matcher.match(answer, reference_u32)) {
+					++cnt_mistakes;
+					++item_mistakes;
+					out.front<TermColor::RED>().append('\'').append(reference).append('\'').reset().append('\n');
+					out.flush();
+					if(_audio) {
+						say(item);
+					}
+					read_line(stdin, answer, true);
+					filter(answer);
+				}
+
+				if(_cli.review_file.presented()) {
+					_review.grade(item.hash(), item_mistakes, time(nullptr));
+				}
+			}
+			++cnt_total;
+		}
+
+		if(is_test && _cli.review_file.presented() && (not _review.save(_cli.review_file.value().c_str()))) {
+			fprintf(stderr, "Review file '%s' cannot be written.\n", _cli.review_file.value().c_str());
+		}
+
+		double cnt_mistakes_percent = cnt_mistakes;
+		cnt_mistakes_percent /= cnt_total;
+		cnt_mistakes_percent *= 100.;
+		printf("Mistakes : %u (%.2f%%).", cnt_mistakes, cnt_mistakes_percent);
+		const unsigned seconds_total = time(nullptr) - tm_before;
+		printf(" %u seconds.\n", seconds_total);
+		// Waits for the queued speech, so it is in the stats.
+		_audio.reset();
+		return EXIT_SUCCESS;
+	}
+
+private:
+
+	/**
+	 * Exact comparison unless the fuzzy matching is asked for, the alternatives
+	 * are accepted if the answer is a translation and the normalization or typos are on.
+	 */
+	AnswerMatcher make_matcher() const {
+		const bool is_translation = _cli.answer.presented()
+			&& (_cli.answer.value().get() == NihongoNoTangoCli::EnumAnswer::TRANSLATION);
+		const bool alternatives = is_translation && (_cli.normalize.presented() || _cli.typos.value() > 0);
+		return AnswerMatcher(_cli.normalize.presented(), alternatives, _cli.typos.value());
+	}
+
+	/**
+	 * @return The records of the session : the scheduled ones if the review state is used,
+	 * a uniform sample otherwise. Only the records of the selected sources are asked.
+	 */
+	std::vector<size_t> select_session() {
+		const Stats::Timer timer(_stats, Stats::SELECT);
+		const size_t candidates = select_sources();
+		const auto rounds_max = std::min(_cli.rounds.value(), candidates);
+		std::vector<size_t> session;
+		session.reserve(rounds_max);
+		if(_cli.review_file.presented()) {
+			_review.prepare(_dic, candidates, _dm, time(nullptr));
+			size_t idx;
+			while(session.size() < rounds_max && _review.next(idx)) {
+				session.push_back(idx);
+			}
+		} else {
+			_dm.sample(_dic.begin(), _dic.begin() + candidates, rounds_max);
+			for(size_t idx = 0; idx < rounds_max; ++idx) {
+				session.push_back(idx);
+			}
+		}
+		return session;
+	}
+
+	/**
+	 * Moves the records of the sources matching the filter to the front of the dictionary.
+	 * @return The number of these records.
+	 */
+	size_t select_sources() {
+		if(not _cli.source_filter.presented()) {
+			return _dic.size();
+		}
+		std::vector<bool> selected(_sources.size());
+		for(size_t idx = 0; idx < _sources.size(); ++idx) {
+			selected[idx] = DictionarySources::matches(_sources[idx], _cli.source_filter.value());
+		}
+		const auto last = std::stable_partition(_dic.begin(), _dic.end(),
+			[&selected](const DictionaryStore::Entry& entry) { return selected[entry.source]; });
+		return size_t(last - _dic.begin());
+	}
+
+	void build_index() {
+		const Stats::Timer timer(_stats, Stats::INDEX);
+		_index.build(_dic, _cli.jobs.value());
+	}
+
+	void build_suffixes() {
+		const Stats::Timer timer(_stats, Stats::INDEX);
+		_suffixes.build(_dic, _cli.jobs.value());
+	}
+
+	void watch() {
+		const std::string& path = _sources.front();
+		MappedFile file;
+		std::string inflated;
+		std::string_view text;
+		if(_watcher.open(path) && open_text(path, file, inflated, text)) {
+			_reloader.reset(text, _dic);
+		} else {
+			_watcher.close();
+			fprintf(stderr, "Dictionary file '%s' cannot be watched.\n", path.c_str());
+		}
+	}
+
+	/**
+	 * Applies the edits of the dictionary file made since the previous round.
+	 */
+	void reload() {
+		MappedFile file;
+		std::string inflated;
+		std::string_view text;
+		if(_watcher.changed() && open_text(_sources.front(), file, inflated, text)) {
+			const Stats::Timer timer(_stats, Stats::RELOAD);
+			const auto stat = _reloader.update(text, _dic);
+			printf("Dictionary reloaded : %zu replaced, %zu added, %zu removed.\n", stat.replaced, stat.added, stat.erased);
+		}
+	}
+
+	/**
+	 * Resolves the dictionary arguments into the source files, in the argument order.
+	 */
+	int expand_sources() {
+		const Stats::Timer timer(_stats, Stats::SOURCES);
+		int err = DictionarySources::expand(_cli.dic_file.value(), _sources) ? EXIT_SUCCESS : EXIT_FAILURE;
+		if(err == EXIT_SUCCESS && _sources.size() > SOURCES_MAX) {
+			err = EXIT_FAILURE;
+			fprintf(stderr, "Too many dictionary files : %zu, up to %zu are supported.\n", _sources.size(), SOURCES_MAX);
+		}
+		return err;
+	}
+
+	/**
+	 * Loads the dictionary file @path from its image if it is up to date, otherwise parses it.
+	 * @param suffixes - receives the suffix array of the image, nullptr to skip it.
+	 */
+	int load_file(const std::string& path, DictionaryStore& dic, SuffixIndex* suffixes, const unsigned threads) {
+		struct stat source;
+		const auto start = _stats.now();
+		const bool has_image = (stat(path.c_str(), &source) == 0)
+			&& DictionaryImage::read(DictionaryImage::path_for(path).c_str(), source, dic, suffixes);
+		if(has_image) {
+			_stats.add(Stats::IMAGE, start);
+		}
+		return has_image ? EXIT_SUCCESS : load_text(path, dic, threads);
+	}
+
+	/**
+	 * Loads the source files concurrently, a file per worker, and merges them in the argument order.
+	 * The records are tagged with the index of their source, the duplicates are dropped.
+	 */
+	int load_files() {
+		std::vector<DictionaryStore> parts(_sources.size());
+		std::vector<int> errs(_sources.size(), EXIT_SUCCESS);
+		Parallel::for_each(_sources.size(), Parallel::concurrency(_cli.jobs.value()), [this, &parts, &errs](const size_t idx) {
+			errs[idx] = load_file(_sources[idx], parts[idx], nullptr, 1u);
+		});
+
+		const Stats::Timer timer(_stats, Stats::MERGE);
+		int err = EXIT_SUCCESS;
+		size_t records = 0;
+		size_t pool_bytes = 0;
+		for(size_t idx = 0; idx < parts.size(); ++idx) {
+			err = (errs[idx] == EXIT_SUCCESS) ? err : errs[idx];
+			records += parts[idx].size();
+			pool_bytes += parts[idx].pool_size();
+		}
+		_dic.clear();
+		_dic.reserve(records, pool_bytes);
+		for(size_t idx = 0; err == EXIT_SUCCESS && idx < parts.size(); ++idx) {
+			const size_t first = _dic.size();
+			if(_dic.append(parts[idx])) {
+				for(auto* entry = _dic.begin() + first; entry != _dic.end(); ++entry) {
+					entry->source = static_cast<uint16_t>(idx);
+				}
+				parts[idx].clear();
+			} else {
+				err = EXIT_FAILURE;
+				fprintf(stderr, "Dictionary file '%s' does not fit into the dictionary.\n", _sources[idx].c_str());
+			}
+		}
+		if(err == EXIT_SUCCESS) {
+			// The selected files go first, so a record repeated across the files keeps a selected copy.
+			select_sources();
+			const size_t dups = _dic.deduplicate();
+			printf("%zu lines loaded from %zu files, %zu duplicates removed.\n", _dic.size(), _sources.size(), dups);
+		}
+		return err;
+	}
+
+	/**
+	 * Parses the text dictionary @path, a gzip one is parsed while it is being inflated.
+	 */
+	int load_text(const std::string& path, DictionaryStore& dic, const unsigned threads) {
+		int err = EXIT_SUCCESS;
+		MappedFile file;
+		dic.clear();
+		if(not file.open(path.c_str())) {
+			err = EXIT_FAILURE;
+			fprintf(stderr, "Dictionary file '%s' is not available for reading.\n", path.c_str());
+		} else if(CompressedInput::detect(file.view()) == CompressedInput::PLAIN) {
+			const Stats::Timer timer(_stats, Stats::PARSE);
+			DictionaryParser::parse(file.view(), dic, threads);
+		} else if(CompressedInput::detect(file.view()) == CompressedInput::GZIP) {
+			// The parsing overlaps with the inflating, the both are timed together.
+			const Stats::Timer timer(_stats, Stats::INFLATE);
+			DictionaryParser::Stream stream(dic, CompressedInput::size_hint(file.view()));
+			if(not CompressedInput::inflate(file.view(), [&stream](const std::string_view& block) { stream.feed(block); })) {
+				err = EXIT_FAILURE;
+				fprintf(stderr, "Dictionary file '%s' is corrupt.\n", path.c_str());
+			}
+		} else {
+			err = EXIT_FAILURE;
+			fprintf(stderr, "Dictionary file '%s' is %s-compressed, which is not supported.\n",
+				path.c_str(), CompressedInput::to_cstr(CompressedInput::detect(file.view())));
+		}
+		dic.shrink_to_fit();
+		return err;
+	}
+
+	/**
+	 * Maps the dictionary file @path, a gzip one is inflated into @inflated.
+	 * @param text - receives the text of the dictionary.
+	 */
+	static bool open_text(const std::string& path, MappedFile& file, std::string& inflated, std::string_view& text) {
+		bool result = file.open(path.c_str());
+		const auto format = result ? CompressedInput::detect(file.view()) : CompressedInput::PLAIN;
+		if(format == CompressedInput::GZIP) {
+			result = CompressedInput::inflate(file.view(), inflated);
+			text = inflated;
+			file.close();
+		} else {
+			result = result && (format == CompressedInput::PLAIN);
+			text = file.view();
+		}
+		return result;
+	}
+
+	int compile(const std::string& path) {
+		const std::string image_path = DictionaryImage::path_for(path);
+		struct stat source;
+		int err = load_text(path, _dic, _cli.jobs.value());
+		if(err == EXIT_SUCCESS) {
+			build_suffixes();
+			const auto start = _stats.now();
+			if(stat(path.c_str(), &source) == 0
+				&& DictionaryImage::write(image_path.c_str(), _dic, _suffixes, source)
+				&& DictionaryImage::verify(image_path.c_str())) {
+				_stats.add(Stats::WRITE, start);
+				printf("%zu lines compiled into '%s'.\n", _dic.size(), image_path.c_str());
+			} else {
+				err = EXIT_FAILURE;
+				fprintf(stderr, "Dictionary image '%s' cannot be written.\n", image_path.c_str());
+			}
+		}
+		return err;
+	}
+
+	int load_review() {
+		const Stats::Timer timer(_stats, Stats::REVIEW);
+		int err = EXIT_SUCCESS;
+		if(_cli.review_file.presented() && (not _review.load(_cli.review_file.value().c_str()))) {
+			err = EXIT_FAILURE;
+			fprintf(stderr, "Review file '%s' is malformed.\n", _cli.review_file.value().c_str());
+		}
+		return err;
+	}
+
+	/**
+	 * Samples the session across the selected source files as if they were one.
+	 */
+	int load_sample() {
+		int err = EXIT_SUCCESS;
+		std::vector<size_t> picked;
+		for(size_t idx = 0; idx < _sources.size(); ++idx) {
+			if((not _cli.source_filter.presented()) || DictionarySources::matches(_sources[idx], _cli.source_filter.value())) {
+				picked.push_back(idx);
+			}
+		}
+		std::vector<MappedFile> files(picked.size());
+		std::vector<std::string> inflated(picked.size());
+		std::vector<std::string_view> texts(picked.size());
+		for(size_t idx = 0; idx < picked.size(); ++idx) {
+			const std::string& path = _sources[picked[idx]];
+			if(not open_text(path, files[idx], inflated[idx], texts[idx])) {
+				err = EXIT_FAILURE;
+				fprintf(stderr, "Dictionary file '%s' is not available for reading.\n", path.c_str());
+			}
+		}
+		if(err == EXIT_SUCCESS) {
+			DictionarySampler sampler(_dm, _cli.rounds.value());
+			const auto stat = sampler.sample(texts.data(), texts.size(), _dic);
+			for(auto& entry : _dic) {
+				entry.source = static_cast<uint16_t>(picked[entry.source]);
+			}
+			printf("%zu of %zu lines sampled.\n", _dic.size(), stat.candidates);
+		}
+		return err;
+	}
+
+	void filter(String_t& text) const {
+		if(_cli.katakana_filter.presented()) {
+			_filter.apply(text);
+		}
+	}
+
+	static void read_all(FILE* input, std::string& result) {
+		static constexpr size_t BLOCK = 1u << 16;
+		size_t len = 0;
+		do {
+			result.resize(len + BLOCK);
+			len += fread(&result[len], 1, BLOCK, input);
+		} while(len == result.size());
+		result.resize(len);
+	}
+
+	bool read_line(FILE* input, String_t& result, const bool skip_spaces) {
+		std::string buf;
+		int ch;
+		while((ch = getc(input)) != EOF) {
+			if(ch == '\n') {
+				break;
+			}
+			if(skip_spaces && isspace(ch)) {
+				continue;
+			}
+			buf.push_back(ch);
+		}
+		Utf8::decode(buf, result);
+		return ch != EOF;
+	}
+
+	void say(const Record& rec) {
+		_audio->play(speech(rec));
+	}
+
+	static std::string_view speech(const Record& rec) {
+		return rec.kanji.empty() ? rec.kana : rec.kanji;
+	}
+
+};
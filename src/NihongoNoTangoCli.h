@@ -2,21 +2,31 @@
 
 #include "AppCli.h"
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 struct NihongoNoTangoCli {
 
 	enum EnumMethod : unsigned {
 		LEARN,
 		TEST,
+		COMPILE,
+		GRADE,
+		LOOKUP,
+		SEARCH,
 		__SIZE
 	};
 
 	struct EnumMethodToCStr {
-		static const char* to_cstr(const EnumMethod& value) {
+		static constexpr const char* to_cstr(const EnumMethod& value) {
 			switch(value) {
 				case EnumMethod::LEARN: return "learn";
 				case EnumMethod::TEST: return "test";
+				case EnumMethod::COMPILE: return "compile";
+				case EnumMethod::GRADE: return "grade";
+				case EnumMethod::LOOKUP: return "lookup";
+				case EnumMethod::SEARCH: return "search";
 				default: return "[UNKNOWN]";
 			}
 		}
@@ -32,7 +42,7 @@ struct NihongoNoTangoCli {
 	};
 
 	struct EnumAnswerCStr {
-		static const char* to_cstr(const EnumAnswer& value) {
+		static constexpr const char* to_cstr(const EnumAnswer& value) {
 			switch(value) {
 				case EnumAnswer::KANA: return "kana";
 				case EnumAnswer::KANJI: return "kanji";
@@ -44,15 +54,51 @@ struct NihongoNoTangoCli {
 
 	using Answer = EnumField<EnumAnswer, EnumAnswerCStr>;
 
+	enum class EnumStats : unsigned {
+		TEXT,
+		JSON,
+		__SIZE
+	};
+
+	struct EnumStatsCStr {
+		static constexpr const char* to_cstr(const EnumStats& value) {
+			switch(value) {
+				case EnumStats::TEXT: return "text";
+				case EnumStats::JSON: return "json";
+				default: return "[UNKNOWN]";
+			}
+		}
+	};
+
+	using StatsFormat = EnumField<EnumStats, EnumStatsCStr>;
+
 	unsigned pr = 1;
-	Option<size_t> rounds = Option<size_t>('r', "Rounds.", ++pr);
-	Option<std::string> dic_file = Option<std::string>('d', "Dictionary file.", ++pr);
-	OptionFlag show_kanji = OptionFlag('j', "Show kanji.", ++pr);
-	OptionFlag show_kana = OptionFlag('k', "Show kana.", ++pr);
-	OptionFlag show_translation = OptionFlag('t', "Show translation.", ++pr);
-	OptionFlag play_audio = OptionFlag('p', "Play audio.", ++pr);
-	OptionFlag katakana_filter = OptionFlag('f', "Katakana filter.", ++pr);
-	Option<Answer> answer = Option<Answer>('a', Answer::description(), ++pr);
+	Option<size_t> rounds = Option<size_t>('r', "rounds", "Rounds.", ++pr);
+	Option<std::vector<std::string>> dic_file = Option<std::vector<std::string>>('d', "dictionary", "Dictionary files, directories or glob patterns, repeatable.", ++pr);
+	OptionFlag show_kanji = OptionFlag('j', "show-kanji", "Show kanji.", ++pr);
+	OptionFlag show_kana = OptionFlag('k', "show-kana", "Show kana.", ++pr);
+	OptionFlag show_translation = OptionFlag('t', "show-translation", "Show translation.", ++pr);
+	OptionFlag play_audio = OptionFlag('p', "play-audio", "Play audio.", ++pr);
+	OptionFlag katakana_filter = OptionFlag('f', "katakana-filter", "Katakana filter.", ++pr);
+	Option<Answer> answer = Option<Answer>('a', "answer", Answer::description(), ++pr);
+	Option<unsigned> jobs = Option<unsigned>('J', "jobs", "Worker threads, 0 - all the cores.", ++pr, 0u);
+	OptionFlag stream_sample = OptionFlag('s', "stream-sample", "Sample the rounds while streaming the dictionary.", ++pr);
+	Option<uint64_t> seed = Option<uint64_t>('e', "seed", "Random seed, the current time by default.", ++pr);
+	Option<std::string> review_file = Option<std::string>('v', "review-file", "Spaced repetition state file.", ++pr);
+	Option<std::string> audio_cmd = Option<std::string>('g', "audio-cmd", "Speech command, {text} - the text, {file} - the output to cache. "
+		"Only a command writing {file} is cached and prefetched, a command without it speaks by itself.", ++pr,
+		"trans -b :en :jpn -download-audio-as {file} {text} > /dev/null");
+	Option<std::string> audio_player = Option<std::string>('o', "audio-player", "Player of the cached speech, {file} - the file.", ++pr,
+		"mpv --no-video --really-quiet {file} > /dev/null");
+	OptionFlag normalize = OptionFlag('n', "normalize", "Normalize the answers : kana, widths, long vowels, spaces, case.", ++pr);
+	OptionFlag reload = OptionFlag('R', "reload", "Reload the edited dictionary between the rounds.", ++pr);
+	Option<std::string> katakana_map = Option<std::string>('x', "katakana-map", "Katakana filter mapping file, '<from> <to>' lines.", ++pr);
+	Option<std::string> input_file = Option<std::string>('i', "input-file", "Answers to grade, '<key>\\t<answer>' lines, '-' - the standard input.", ++pr);
+	Option<std::string> query = Option<std::string>('w', "query", "Kanji, kana or translation to look up, a part of it to search for.", ++pr);
+	Option<unsigned> typos = Option<unsigned>('l', "typos", "Typos accepted in a translation, its ','-separated alternatives are accepted too.", ++pr, 0u);
+	Option<StatsFormat> stats = Option<StatsFormat>('z', "stats", "Timings and counters printed to stderr on exit. " + StatsFormat::description(), ++pr);
+	Option<std::string> config_file = Option<std::string>('c', "config", "Config file of `key = value` lines, the keys are the long option names.", ++pr);
+	Option<std::vector<std::string>> source_filter = Option<std::vector<std::string>>('S', "source-filter", "Dictionary files to ask from, glob patterns of the paths or names, repeatable.", ++pr);
 
 	AppCliMethod<Method> action;
 
@@ -60,13 +106,36 @@ struct NihongoNoTangoCli {
 		action[EnumMethod::LEARN]
 			.desc("Learning.")
 			.mand(rounds, dic_file)
-			.opt(show_kanji, show_kana, show_translation, play_audio, katakana_filter);
+			.opt(show_kanji, show_kana, show_translation, play_audio, katakana_filter, jobs, stream_sample, seed, review_file,
+				audio_cmd, audio_player, reload, source_filter, stats, config_file);
 
 		action[EnumMethod::TEST]
 			.desc("Testing.")
 			.mand(rounds, dic_file, answer)
-			.opt(show_kanji, show_kana, show_translation, play_audio, katakana_filter);
-
+			.opt(show_kanji, show_kana, show_translation, play_audio, katakana_filter, jobs, stream_sample, seed, review_file,
+				audio_cmd, audio_player, normalize, typos, katakana_map, reload, source_filter, stats, config_file);
+
+		action[EnumMethod::COMPILE]
+			.desc("Dictionary image compilation.")
+			.mand(dic_file)
+			.opt(jobs, stats, config_file);
+
+		action[EnumMethod::GRADE]
+			.desc("Grading of the answers from a file.")
+			.mand(dic_file, answer, input_file)
+			.opt(jobs, katakana_filter, normalize, typos, katakana_map, stats, config_file);
+
+		action[EnumMethod::LOOKUP]
+			.desc("Lookup of the records by a field.")
+			.mand(dic_file, query)
+			.opt(jobs, stats, config_file);
+
+		action[EnumMethod::SEARCH]
+			.desc("Search of the records containing a text.")
+			.mand(dic_file, query)
+			.opt(jobs, stats, config_file);
+
+		action.sources("NIHONGO_", config_file);
 		action.finalize();
 	}
 
@@ -76,16 +145,27 @@ struct NihongoNoTangoCli {
 
 	bool validate() const {
 		bool result = (not dic_file.value().empty());
-		result = result && (show_kanji.presented() || show_kana.presented() || play_audio.presented());
-		result = result && (rounds > 0);
+		if(is_quiz()) {
+			result = result && (show_kanji.presented() || show_kana.presented() || play_audio.presented());
+			result = result && (rounds > 0);
+			// The schedule covers the whole dictionary, a streamed sample is not enough for it.
+			result = result && not (stream_sample.presented() && review_file.presented());
+			// A streamed sample is not the whole dictionary, it cannot follow the edits.
+			result = result && not (stream_sample.presented() && reload.presented());
+		}
+		result = result && ((not katakana_map.presented()) || katakana_filter.presented());
 		return result;
 	}
 
+	bool is_quiz() const {
+		return action.action() == EnumMethod::LEARN || action.action() == EnumMethod::TEST;
+	}
+
 	void print_usage(FILE* out, const char* bin) {
 		action.print_usage(out, bin);
 	}
 
-	std::string options_string() const {
+	const char* options_string() const {
 		return action.options_string();
 	}
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs independent tasks on a bounded number of threads.
+ */
+struct Parallel {
+
+	/**
+	 * @param requested - 0 means all the available cores.
+	 */
+	static unsigned concurrency(const unsigned requested) {
+		const unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+		return requested > 0 ? requested : hw;
+	}
+
+	/**
+	 * Calls fn(idx) for every idx in [0, count).
+	 * The tasks are taken in the index order by @threads workers, the calling thread is one of them.
+	 */
+	template <typename F>
+	static void for_each(const size_t count, const unsigned threads, F&& fn) {
+		const size_t workers = std::min<size_t>(std::max(1u, threads), count);
+		if(workers <= 1u) {
+			for(size_t idx = 0; idx < count; ++idx) {
+				fn(idx);
+			}
+		} else {
+			std::atomic<size_t> next(0);
+			const auto worker = [&next, &fn, count]() {
+				for(size_t idx = next++; idx < count; idx = next++) {
+					fn(idx);
+				}
+			};
+			std::vector<std::thread> pool;
+			pool.reserve(workers - 1u);
+			for(size_t i = 1; i < workers; ++i) {
+				pool.emplace_back(worker);
+			}
+			worker();
+			for(auto& thread : pool) {
+				thread.join();
+			}
+		}
+	}
+
+};
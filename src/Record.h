@@ -0,0 +1,168 @@
+#pragma once
+
+#include "Hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * A dictionary record as UTF-8 slices of some backing buffer.
+ *
+ * A field is either raw, or contains '\' escapes (`\;` is a literal semicolon),
+ * or is enclosed in double quotes (`"a;b"`, `""` is a literal quote).
+ * A slice of an escaped field still holds the escapes, unescape() produces the text.
+ */
+struct Record {
+
+	enum Escaping : uint8_t {
+		RAW,
+		BACKSLASH,
+		QUOTED
+	};
+
+	static constexpr size_t FIELDS = 3;
+	static constexpr char DELIMITER = ';';
+	static constexpr char ESCAPE = '\\';
+	static constexpr char QUOTE = '"';
+
+	std::string_view kanji;
+	std::string_view kana;
+	std::string_view translation;
+	Escaping escaping[FIELDS] = {RAW, RAW, RAW};
+
+	/**
+	 * Parses a `kanji;kana;translation` line in place, one pass, no allocations.
+	 * The fields are trimmed, a single trailing delimiter is ignored.
+	 * @return true if the line is a valid record.
+	 */
+	bool read(const std::string_view& line) {
+		std::string_view* const fields[FIELDS] = {&kanji, &kana, &translation};
+		const size_t size = line.size();
+		size_t cnt = 0;
+		size_t pos = 0;
+		bool result = true;
+
+		while(result) {
+			pos = skip_spaces(line, pos);
+			size_t begin = pos;
+			size_t end;
+			Escaping esc = RAW;
+
+			if(pos < size && line[pos] == QUOTE) {
+				begin = ++pos;
+				result = false;
+				while(pos < size) {
+					if(line[pos] == QUOTE) {
+						if(pos + 1u < size && line[pos + 1u] == QUOTE) {
+							esc = QUOTED;
+							pos += 2u;
+							continue;
+						}
+						result = true;
+						break;
+					}
+					++pos;
+				}
+				end = pos++;
+				pos = skip_spaces(line, pos);
+				result = result && (pos == size || line[pos] == DELIMITER);
+			} else {
+				while(pos < size && line[pos] != DELIMITER) {
+					if(line[pos] == ESCAPE && pos + 1u < size) {
+						esc = BACKSLASH;
+						++pos;
+					}
+					++pos;
+				}
+				end = pos;
+				while(end > begin && is_space(line[end - 1u]) && not is_escaped(line, begin, end - 1u)) {
+					--end;
+				}
+			}
+
+			if(result) {
+				if(cnt < FIELDS) {
+					*fields[cnt] = line.substr(begin, end - begin);
+					escaping[cnt] = esc;
+					++cnt;
+				} else {
+					result = false;
+				}
+			}
+
+			// The delimiter is consumed, a trailing one closes the record.
+			if(pos >= size || ++pos == size) {
+				break;
+			}
+		}
+
+		return result && (cnt == FIELDS) && (not kana.empty()) && (not translation.empty());
+	}
+
+	/**
+	 * Stable key of the record, meaningful for unescaped fields.
+	 */
+	uint64_t hash() const {
+		static constexpr char SEPARATOR = '\x1F';
+		Fnv1a hash;
+		hash.mix(kanji);
+		hash.mix(&SEPARATOR, 1);
+		hash.mix(kana);
+		hash.mix(&SEPARATOR, 1);
+		hash.mix(translation);
+		return hash.value;
+	}
+
+	bool operator==(const Record& rv) const {
+		return kanji == rv.kanji && kana == rv.kana && translation == rv.translation;
+	}
+
+	bool is_raw() const {
+		return escaping[0] == RAW && escaping[1] == RAW && escaping[2] == RAW;
+	}
+
+	/**
+	 * Writes the text of an escaped field into @out, which holds at least @field.size() bytes.
+	 * @return The length of the text.
+	 */
+	static size_t unescape(const std::string_view& field, const Escaping esc, char* out) {
+		size_t len = 0;
+		for(size_t pos = 0; pos < field.size(); ++pos) {
+			const char ch = field[pos];
+			if(esc == BACKSLASH && ch == ESCAPE && pos + 1u < field.size()) {
+				++pos;
+			} else if(esc == QUOTED && ch == QUOTE) {
+				++pos;
+			}
+			out[len++] = field[pos];
+		}
+		return len;
+	}
+
+private:
+
+	static bool is_space(const char ch) {
+		return ch == ' ' || ch == '\t';
+	}
+
+	static size_t skip_spaces(const std::string_view& line, size_t pos) {
+		while(pos < line.size() && is_space(line[pos])) {
+			++pos;
+		}
+		return pos;
+	}
+
+	/**
+	 * @return true if the character at @pos is preceded by an odd number of escapes.
+	 */
+	static bool is_escaped(const std::string_view& line, const size_t begin, size_t pos) {
+		size_t cnt = 0;
+		while(pos > begin && line[pos - 1u] == ESCAPE) {
+			++cnt;
+			--pos;
+		}
+		return (cnt & 1u) != 0;
+	}
+
+};
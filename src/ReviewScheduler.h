@@ -0,0 +1,230 @@
+#pragma once
+
+#include "DiceMachine.h"
+#include "DictionaryStore.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+/**
+ * SM-2 spaced repetition over the dictionary.
+ *
+ * The state of a card is kept in a side file keyed by Record::hash(), so it survives
+ * reordering and editing of the other lines of the dictionary.
+ * A session takes the overdue cards first (the most overdue first), then the new
+ * cards in random order, then the cards which are not due yet (the nearest first).
+ */
+class ReviewScheduler {
+public:
+
+	struct Card {
+		uint64_t key;
+		int64_t due;
+		uint32_t interval;
+		uint16_t ease;
+		uint16_t reps;
+	};
+
+	static_assert(sizeof(Card) == 24u, "Unexpected Card padding.");
+
+private:
+
+	static constexpr char MAGIC[8] = {'N', 'N', 'T', 'S', 'R', 'S', '\0', '\0'};
+	static constexpr uint32_t VERSION = 1;
+
+	static constexpr uint16_t EASE_INITIAL = 2500;
+	static constexpr uint16_t EASE_MIN = 1300;
+	static constexpr uint16_t EASE_MAX = 5000;
+	static constexpr uint32_t INTERVAL_MAX = 36500;
+	static constexpr int64_t DAY = 24 * 60 * 60;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t card_size;
+		uint64_t count;
+	};
+
+	enum Tier : uint64_t {
+		OVERDUE,
+		NEW,
+		PENDING
+	};
+
+	/**
+	 * Min-heap item : the tier in the upper bits, the due time or a random number below.
+	 */
+	struct Slot {
+		uint64_t priority;
+		uint32_t record;
+
+		bool operator>(const Slot& rv) const {
+			return priority > rv.priority;
+		}
+	};
+
+	static constexpr unsigned TIER_SHIFT = 62;
+
+	std::vector<Card> _cards;
+	std::vector<Slot> _heap;
+
+public:
+
+	/**
+	 * Reads the state file, an absent file is an empty state.
+	 * @return false if the file exists but is malformed.
+	 */
+	bool load(const char* path) {
+		_cards.clear();
+		FILE* file = fopen(path, "rb");
+		bool result = true;
+		if(file) {
+			Header hdr;
+			result = (fread(&hdr, sizeof(hdr), 1, file) == 1);
+			result = result && (memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) == 0);
+			result = result && (hdr.version == VERSION) && (hdr.card_size == sizeof(Card));
+			// The count is checked against the file size before anything is allocated for it.
+			struct stat st;
+			result = result && (fstat(fileno(file), &st) == 0) && (st.st_size >= off_t(sizeof(hdr)));
+			result = result && (hdr.count <= (uint64_t(st.st_size) - sizeof(hdr)) / sizeof(Card));
+			if(result) {
+				_cards.resize(hdr.count);
+				result = (hdr.count == 0) || (fread(_cards.data(), sizeof(Card), _cards.size(), file) == _cards.size());
+			}
+			fclose(file);
+			if(not result) {
+				_cards.clear();
+			}
+			std::sort(_cards.begin(), _cards.end(), [](const Card& lv, const Card& rv) { return lv.key < rv.key; });
+		}
+		return result;
+	}
+
+	/**
+	 * Writes the state into a temporary file and renames it over @path.
+	 */
+	bool save(const char* path) const {
+		Header hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+		hdr.version = VERSION;
+		hdr.card_size = sizeof(Card);
+		hdr.count = _cards.size();
+
+		const std::string tmp_path = std::string(path) + ".tmp";
+		FILE* file = fopen(tmp_path.c_str(), "wb");
+		bool result = (file != nullptr);
+		if(result) {
+			result = (fwrite(&hdr, sizeof(hdr), 1, file) == 1);
+			result = result && (_cards.empty() || fwrite(_cards.data(), sizeof(Card), _cards.size(), file) == _cards.size());
+			result = (fclose(file) == 0) && result;
+			result = result && (rename(tmp_path.c_str(), path) == 0);
+			if(not result) {
+				remove(tmp_path.c_str());
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Builds the priority queue over the first @count records of @dic, O(N).
+	 */
+	void prepare(const DictionaryStore& dic, const size_t count, DiceMachine& dm, const int64_t now) {
+		_heap.clear();
+		_heap.reserve(count);
+		for(size_t idx = 0; idx < count; ++idx) {
+			const Card* card = find(dic[idx].hash());
+			Slot slot;
+			slot.record = static_cast<uint32_t>(idx);
+			if(card == nullptr) {
+				slot.priority = (uint64_t(NEW) << TIER_SHIFT) | (dm.next_u64() >> 2);
+			} else {
+				const auto due = static_cast<uint64_t>(std::max<int64_t>(card->due, 0)) & ((uint64_t(1) << TIER_SHIFT) - 1u);
+				slot.priority = (uint64_t(card->due <= now ? OVERDUE : PENDING) << TIER_SHIFT) | due;
+			}
+			_heap.push_back(slot);
+		}
+		std::make_heap(_heap.begin(), _heap.end(), std::greater<Slot>());
+	}
+
+	/**
+	 * Pops the next record to review, O(log N).
+	 * @return false if the queue is empty.
+	 */
+	bool next(size_t& record) {
+		const bool result = not _heap.empty();
+		if(result) {
+			std::pop_heap(_heap.begin(), _heap.end(), std::greater<Slot>());
+			record = _heap.back().record;
+			_heap.pop_back();
+		}
+		return result;
+	}
+
+	/**
+	 * Updates the card of @key after an answer.
+	 * A card recalled before it is due is rescheduled from @now with the same interval,
+	 * the sessions filled up with the pending cards do not inflate the intervals.
+	 * @param mistakes - the number of wrong answers before the right one.
+	 */
+	void grade(const uint64_t key, const unsigned mistakes, const int64_t now) {
+		Card& card = find_or_add(key);
+		// SM-2 quality : 5 is a perfect recall, below 3 is a lapse.
+		const int quality = (mistakes == 0) ? 5 : std::max(0, 3 - int(mistakes));
+		if(quality >= 3 && now < card.due) {
+			card.due = now + int64_t(card.interval) * DAY;
+			return;
+		}
+		if(quality < 3) {
+			card.reps = 0;
+			card.interval = 1;
+		} else {
+			if(card.reps == 0) {
+				card.interval = 1;
+			} else if(card.reps == 1) {
+				card.interval = 6;
+			} else {
+				const uint64_t interval = (uint64_t(card.interval) * card.ease + 500u) / 1000u;
+				card.interval = static_cast<uint32_t>(std::min<uint64_t>(interval, INTERVAL_MAX));
+			}
+			card.reps = static_cast<uint16_t>(std::min<unsigned>(card.reps + 1u, UINT16_MAX));
+		}
+		const int penalty = 5 - quality;
+		const int ease = int(card.ease) + 100 - penalty * (80 + penalty * 20);
+		card.ease = static_cast<uint16_t>(std::clamp(ease, int(EASE_MIN), int(EASE_MAX)));
+		card.due = now + int64_t(card.interval) * DAY;
+	}
+
+	size_t size() const {
+		return _cards.size();
+	}
+
+private:
+
+	const Card* find(const uint64_t key) const {
+		const auto it = std::lower_bound(_cards.begin(), _cards.end(), key, [](const Card& card, const uint64_t k) { return card.key < k; });
+		return (it != _cards.end() && it->key == key) ? &(*it) : nullptr;
+	}
+
+	Card& find_or_add(const uint64_t key) {
+		auto it = std::lower_bound(_cards.begin(), _cards.end(), key, [](const Card& card, const uint64_t k) { return card.key < k; });
+		if(it == _cards.end() || it->key != key) {
+			Card card;
+			card.key = key;
+			card.due = 0;
+			card.interval = 0;
+			card.ease = EASE_INITIAL;
+			card.reps = 0;
+			it = _cards.insert(it, card);
+		}
+		return *it;
+	}
+
+};
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * Instrumentation of the load and the session : phase timings, latency histograms
+ * and the allocation count, reported on exit as text or JSON.
+ *
+ * Disabled, a probe is a branch on a flag and the clock is not read.
+ * The phases may be timed on the worker threads, the histograms on the main thread only.
+ */
+class Stats {
+public:
+
+	using Clock_t = std::chrono::steady_clock;
+
+	enum Phase : unsigned {
+		SOURCES,
+		IMAGE,
+		PARSE,
+		INFLATE,
+		MERGE,
+		REVIEW,
+		INDEX,
+		WRITE,
+		SELECT,
+		RELOAD,
+		AUDIO,
+		PHASES
+	};
+
+	enum Latency : unsigned {
+		RESPONSE,
+		LATENCIES
+	};
+
+	/**
+	 * The operator new calls since the enabled stats are created, counted by main.cpp.
+	 */
+	static inline std::atomic<uint64_t> allocations{0};
+	static inline std::atomic<bool> counting{false};
+
+	/**
+	 * Adds the time from the construction to the destruction to a phase.
+	 */
+	class Timer {
+		Stats& _stats;
+		const Phase _phase;
+		const Clock_t::time_point _start;
+
+	public:
+
+		Timer(Stats& stats, const Phase phase) : _stats(stats), _phase(phase), _start(stats.now()) {}
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		~Timer() {
+			_stats.add(_phase, _start);
+		}
+	};
+
+private:
+
+	/**
+	 * Log-linear buckets : exact below SUB_BUCKETS * 2 ns, then SUB_BUCKETS per power of 2,
+	 * a percentile is off by 1 / SUB_BUCKETS at most.
+	 */
+	class Histogram {
+	public:
+
+		static constexpr unsigned SUB_BITS = 3;
+		static constexpr unsigned SUB_BUCKETS = 1u << SUB_BITS;
+		static constexpr unsigned LINEAR = SUB_BUCKETS * 2u;
+		static constexpr unsigned BUCKETS = LINEAR + (64u - SUB_BITS - 1u) * SUB_BUCKETS;
+
+	private:
+
+		uint64_t _counts[BUCKETS] = {};
+		uint64_t _total = 0;
+		uint64_t _sum = 0;
+		uint64_t _max = 0;
+
+	public:
+
+		void add(const uint64_t value) {
+			++_counts[bucket(value)];
+			++_total;
+			_sum += value;
+			_max = (value > _max) ? value : _max;
+		}
+
+		/**
+		 * @param percent - in (0, 100].
+		 * @return The upper bound of the bucket holding the percentile.
+		 */
+		uint64_t percentile(const double percent) const {
+			const auto rank = static_cast<uint64_t>(percent / 100. * double(_total) + 0.5);
+			uint64_t seen = 0;
+			for(unsigned idx = 0; idx < BUCKETS; ++idx) {
+				seen += _counts[idx];
+				if(seen >= rank && seen > 0) {
+					const uint64_t bound = upper_bound(idx);
+					return (bound < _max) ? bound : _max;
+				}
+			}
+			return _max;
+		}
+
+		uint64_t total() const {
+			return _total;
+		}
+
+		uint64_t sum() const {
+			return _sum;
+		}
+
+		uint64_t max() const {
+			return _max;
+		}
+
+	private:
+
+		static unsigned bucket(const uint64_t value) {
+			if(value < LINEAR) {
+				return static_cast<unsigned>(value);
+			}
+			const unsigned exp = 63u - static_cast<unsigned>(__builtin_clzll(value));
+			const auto sub = static_cast<unsigned>(value >> (exp - SUB_BITS)) & (SUB_BUCKETS - 1u);
+			return LINEAR + (exp - SUB_BITS - 1u) * SUB_BUCKETS + sub;
+		}
+
+		static uint64_t upper_bound(const unsigned idx) {
+			if(idx < LINEAR) {
+				return idx;
+			}
+			const unsigned exp = (idx - LINEAR) / SUB_BUCKETS + SUB_BITS + 1u;
+			const uint64_t sub = (idx - LINEAR) % SUB_BUCKETS;
+			return ((SUB_BUCKETS + sub + 1u) << (exp - SUB_BITS)) - 1u;
+		}
+	};
+
+	const bool _enabled;
+	std::atomic<uint64_t> _phase_ns[PHASES] = {};
+	std::atomic<uint64_t> _phase_cnt[PHASES] = {};
+	Histogram _latencies[LATENCIES];
+
+public:
+
+	explicit Stats(const bool enabled) : _enabled(enabled) {
+		if(enabled) {
+			counting.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	Stats(const Stats&) = delete;
+	Stats& operator=(const Stats&) = delete;
+
+	bool enabled() const {
+		return _enabled;
+	}
+
+	/**
+	 * @return The current time, the epoch if disabled.
+	 */
+	Clock_t::time_point now() const {
+		return _enabled ? Clock_t::now() : Clock_t::time_point();
+	}
+
+	/**
+	 * Adds the time since @start to @phase.
+	 */
+	void add(const Phase phase, const Clock_t::time_point start) {
+		if(_enabled) {
+			_phase_ns[phase] += elapsed_ns(start);
+			++_phase_cnt[phase];
+		}
+	}
+
+	/**
+	 * Adds the time since @start to the histogram of @latency.
+	 */
+	void record(const Latency latency, const Clock_t::time_point start) {
+		if(_enabled) {
+			_latencies[latency].add(elapsed_ns(start));
+		}
+	}
+
+	/**
+	 * Prints the report, the phases never entered are omitted.
+	 */
+	void print(FILE* out, const bool json) const {
+		fprintf(out, json ? "{\"phases\":{" : "Phase            count     total ms\n");
+		bool first = true;
+		for(unsigned phase = 0; phase < PHASES; ++phase) {
+			const uint64_t cnt = _phase_cnt[phase];
+			if(cnt == 0) {
+				continue;
+			}
+			const double ms = double(_phase_ns[phase]) / 1e6;
+			const char* name = to_cstr(static_cast<Phase>(phase));
+			if(json) {
+				fprintf(out, "%s\"%s\":{\"count\":%llu,\"ms\":%.3f}", first ? "" : ",", name, (unsigned long long)cnt, ms);
+			} else {
+				fprintf(out, "%-12s %9llu %12.3f\n", name, (unsigned long long)cnt, ms);
+			}
+			first = false;
+		}
+
+		fprintf(out, json ? "},\"latencies\":{" : "Latency          count      mean ms       p50 ms       p90 ms       p99 ms       max ms\n");
+		for(unsigned latency = 0; latency < LATENCIES; ++latency) {
+			const Histogram& hist = _latencies[latency];
+			const char* name = to_cstr(static_cast<Latency>(latency));
+			const double mean = hist.total() ? double(hist.sum()) / double(hist.total()) / 1e6 : 0.;
+			const double p50 = double(hist.percentile(50.)) / 1e6;
+			const double p90 = double(hist.percentile(90.)) / 1e6;
+			const double p99 = double(hist.percentile(99.)) / 1e6;
+			const double max = double(hist.max()) / 1e6;
+			if(json) {
+				fprintf(out, "%s\"%s\":{\"count\":%llu,\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p90_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}",
+					latency ? "," : "", name, (unsigned long long)hist.total(), mean, p50, p90, p99, max);
+			} else {
+				fprintf(out, "%-12s %9llu %12.3f %12.3f %12.3f %12.3f %12.3f\n",
+					name, (unsigned long long)hist.total(), mean, p50, p90, p99, max);
+			}
+		}
+
+		const auto allocs = static_cast<unsigned long long>(allocations.load());
+		if(json) {
+			fprintf(out, "},\"allocations\":%llu}\n", allocs);
+		} else {
+			fprintf(out, "Allocations : %llu.\n", allocs);
+		}
+	}
+
+	static const char* to_cstr(const Phase phase) {
+		switch(phase) {
+			case SOURCES: return "sources";
+			case IMAGE: return "image";
+			case PARSE: return "parse";
+			case INFLATE: return "inflate";
+			case MERGE: return "merge";
+			case REVIEW: return "review";
+			case INDEX: return "index";
+			case WRITE: return "write";
+			case SELECT: return "select";
+			case RELOAD: return "reload";
+			case AUDIO: return "audio";
+			default: return "[UNKNOWN]";
+		}
+	}
+
+	static const char* to_cstr(const Latency latency) {
+		switch(latency) {
+			case RESPONSE: return "response";
+			default: return "[UNKNOWN]";
+		}
+	}
+
+private:
+
+	static uint64_t elapsed_ns(const Clock_t::time_point start) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock_t::now() - start).count());
+	}
+
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "DictionaryStore.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/**
+ * Substring search over the fields of the dictionary.
+ *
+ * A generalized suffix array of the string pool : a suffix starts at a UTF-8 character
+ * of a field and ends with the field, so a match never spans two fields.
+ * The array is either built in memory or attached from the dictionary image,
+ * it is valid while the dictionary is unchanged.
+ */
+class SuffixIndex {
+public:
+
+	struct Suffix {
+		uint32_t pos;
+		uint32_t record;
+	};
+
+	static_assert(sizeof(Suffix) == 8u, "Unexpected Suffix padding.");
+
+private:
+
+	const DictionaryStore* _dic;
+	std::vector<Suffix> _suffixes_buf;
+	const Suffix* _suffixes;
+	size_t _size;
+
+public:
+
+	SuffixIndex() : _dic(nullptr), _suffixes(nullptr), _size(0) {}
+
+	SuffixIndex(const SuffixIndex&) = delete;
+	SuffixIndex& operator=(const SuffixIndex&) = delete;
+
+	/**
+	 * Sorts the suffixes of @dic, the parts are sorted on the worker threads and merged.
+	 */
+	void build(const DictionaryStore& dic, const unsigned threads) {
+		_dic = &dic;
+		std::vector<Key> keys;
+		const std::string_view pool = dic.pool();
+		for(size_t idx = 0; idx < dic.size(); ++idx) {
+			const DictionaryStore::Entry& entry = dic.begin()[idx];
+			const size_t end = entry.offset + size_t(entry.kanji_len) + entry.kana_len + entry.translation_len;
+			for(size_t pos = entry.offset; pos < end; ++pos) {
+				if((static_cast<unsigned char>(pool[pos]) & 0xC0u) != 0x80u) {
+					const Suffix sfx = {static_cast<uint32_t>(pos), static_cast<uint32_t>(idx)};
+					keys.push_back({prefix(suffix(sfx)), sfx});
+				}
+			}
+		}
+
+		// The prefixes order the most of the suffixes, the text is compared on ties only.
+		// Equal suffixes are ordered by the position, so the result does not depend on the parts.
+		const auto less = [this](const Key& lv, const Key& rv) {
+			if(lv.prefix != rv.prefix) {
+				return lv.prefix < rv.prefix;
+			}
+			const int cmp = suffix(lv.sfx).compare(suffix(rv.sfx));
+			return cmp < 0 || (cmp == 0 && lv.sfx.pos < rv.sfx.pos);
+		};
+		const size_t parts = std::min<size_t>(Parallel::concurrency(threads), std::max<size_t>(1u, keys.size() / PART_MIN));
+		const size_t part_size = (keys.size() + parts - 1u) / parts;
+		Parallel::for_each(parts, parts, [&keys, &less, part_size](const size_t part) {
+			const auto first = keys.begin() + std::min(keys.size(), part * part_size);
+			const auto last = keys.begin() + std::min(keys.size(), (part + 1u) * part_size);
+			std::sort(first, last, less);
+		});
+		for(size_t width = part_size; width < keys.size(); width *= 2u) {
+			for(size_t first = 0; first + width < keys.size(); first += width * 2u) {
+				const auto begin = keys.begin() + first;
+				std::inplace_merge(begin, begin + width, begin + std::min(width * 2u, keys.size() - first), less);
+			}
+		}
+
+		_suffixes_buf.resize(keys.size());
+		for(size_t idx = 0; idx < keys.size(); ++idx) {
+			_suffixes_buf[idx] = keys[idx].sfx;
+		}
+		_suffixes = _suffixes_buf.data();
+		_size = _suffixes_buf.size();
+	}
+
+	/**
+	 * Uses the sorted suffixes of @dic kept elsewhere, e.g. in the mapped image.
+	 */
+	void attach(const DictionaryStore& dic, const Suffix* suffixes, const size_t size) {
+		_dic = &dic;
+		_suffixes_buf.clear();
+		_suffixes = suffixes;
+		_size = size;
+	}
+
+	/**
+	 * Collects the records which have @query in any of the fields, in the index order.
+	 */
+	void find(const std::string_view& query, std::vector<uint32_t>& records) const {
+		records.clear();
+		if(query.empty()) {
+			return;
+		}
+		const Suffix* last = _suffixes + _size;
+		const Suffix* it = std::lower_bound(_suffixes, last, query,
+			[this](const Suffix& sfx, const std::string_view& q) { return suffix(sfx) < q; });
+		for(; it != last && suffix(*it).substr(0, query.size()) == query; ++it) {
+			records.push_back(it->record);
+		}
+		std::sort(records.begin(), records.end());
+		records.erase(std::unique(records.begin(), records.end()), records.end());
+	}
+
+	const Suffix* begin() const {
+		return _suffixes;
+	}
+
+	size_t size() const {
+		return _size;
+	}
+
+	bool empty() const {
+		return _size == 0;
+	}
+
+private:
+
+	static constexpr size_t PART_MIN = 1u << 16;
+
+	struct Key {
+		uint64_t prefix;
+		Suffix sfx;
+	};
+
+	/**
+	 * @return The first 8 bytes of @text as a big-endian number, zero-padded.
+	 */
+	static uint64_t prefix(const std::string_view& text) {
+		uint64_t result = 0;
+		for(size_t i = 0; i < sizeof(result); ++i) {
+			result <<= 8u;
+			if(i < text.size()) {
+				result |= static_cast<unsigned char>(text[i]);
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * @return The text from @sfx to the end of its field.
+	 */
+	std::string_view suffix(const Suffix& sfx) const {
+		const DictionaryStore::Entry& entry = _dic->begin()[sfx.record];
+		size_t end = entry.offset + size_t(entry.kanji_len);
+		if(sfx.pos >= end) {
+			end += entry.kana_len;
+			if(sfx.pos >= end) {
+				end += entry.translation_len;
+			}
+		}
+		return _dic->pool().substr(sfx.pos, end - sfx.pos);
+	}
+
+};
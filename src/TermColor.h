@@ -79,7 +79,7 @@ struct TermColor {
 		}
 	}
 
-	static const char* back(const ColorCode clr) {
+	static constexpr const char* back(const ColorCode clr) {
 		switch(clr) {
 			case ColorCode::RED :			return BACK_RED;
 			case ColorCode::GREEN :			return BACK_GREEN;
@@ -102,7 +102,7 @@ struct TermColor {
 		}
 	}
 
-	static const char* reset() {
+	static constexpr const char* reset() {
 		return RESET;
 	}
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "TermColor.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+/**
+ * Composes a screen update in memory and emits it with a single write(2).
+ *
+ * The colors are dropped if the descriptor is not a terminal.
+ * The pending stdio output of the same descriptor is flushed first, so the order is kept.
+ */
+class TermWriter {
+	const int _fd;
+	const bool _colored;
+	std::string _buf;
+
+public:
+
+	static constexpr size_t CAPACITY = 4096;
+
+	explicit TermWriter(const int fd) : _fd(fd), _colored(isatty(fd) == 1) {
+		_buf.reserve(CAPACITY);
+	}
+
+	TermWriter(const TermWriter&) = delete;
+	TermWriter& operator=(const TermWriter&) = delete;
+
+	~TermWriter() {
+		flush();
+	}
+
+	bool colored() const {
+		return _colored;
+	}
+
+	TermWriter& append(const std::string_view& text) {
+		_buf.append(text);
+		return *this;
+	}
+
+	TermWriter& append(const char ch) {
+		_buf.push_back(ch);
+		return *this;
+	}
+
+	/**
+	 * Switches the text color, the escape code is resolved at compile time.
+	 */
+	template <TermColor::ColorCode Color>
+	TermWriter& front() {
+		constexpr std::string_view code = TermColor::front(Color);
+		return color(code);
+	}
+
+	TermWriter& reset() {
+		constexpr std::string_view code = TermColor::reset();
+		return color(code);
+	}
+
+	/**
+	 * Writes the composed text out, the buffer is kept for the next update.
+	 * @return false if the descriptor fails.
+	 */
+	bool flush() {
+		if(_fd == STDOUT_FILENO) {
+			fflush(stdout);
+		}
+		bool result = true;
+		size_t pos = 0;
+		while(result && pos < _buf.size()) {
+			const ssize_t len = write(_fd, _buf.data() + pos, _buf.size() - pos);
+			if(len >= 0) {
+				pos += static_cast<size_t>(len);
+			} else {
+				result = (errno == EINTR);
+			}
+		}
+		_buf.clear();
+		return result;
+	}
+
+private:
+
+	TermWriter& color(const std::string_view& code) {
+		if(_colored) {
+			_buf.append(code);
+		}
+		return *this;
+	}
+
+};
@@ -0,0 +1,484 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NIHONGO_UTF8_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * UTF-8 validation and UTF-8 <-> UTF-32 transcoding.
+ *
+ * Bulk operations have an AVX2 path and an SSE2 path selected at run time,
+ * the scalar code is the reference implementation and handles the tails.
+ * The AVX2 validator is the lookup algorithm by Keiser and Lemire,
+ * the SSE2 path skips ASCII runs and validates the rest with the scalar code.
+ */
+struct Utf8 {
+
+	/**
+	 * @return true if @str contains only 7-bit characters.
+	 */
+	static bool is_ascii(const std::string_view& str) {
+		return impl().is_ascii(str.data(), str.size());
+	}
+
+	/**
+	 * @return true if @str is well-formed UTF-8 :
+	 * no overlong forms, no surrogates, nothing above U+10FFFF, no truncated sequences.
+	 */
+	static bool validate(const std::string_view& str) {
+		return impl().validate(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+	}
+
+	/**
+	 * Validates @in and converts it into @out.
+	 * @return false if @in is malformed, @out is cleared in that case.
+	 */
+	static bool decode(const std::string_view& in, std::u32string& out) {
+		const auto* src = reinterpret_cast<const uint8_t*>(in.data());
+		out.clear();
+		bool result = true;
+		if(impl().is_ascii(in.data(), in.size())) {
+			out.resize(in.size());
+			widen_ascii(src, in.size(), out.data());
+		} else if(impl().validate(src, in.size())) {
+			out.resize(in.size());
+			out.resize(decode_valid(src, in.size(), out.data()));
+		} else {
+			result = false;
+		}
+		return result;
+	}
+
+	/**
+	 * Appends the UTF-8 form of @in to @out.
+	 * Code points outside of the Unicode range and surrogates are replaced by U+FFFD.
+	 */
+	static void encode(const std::u32string_view& in, std::string& out) {
+		const size_t base = out.size();
+		out.resize(base + in.size() * 4u);
+		char* dst = out.data() + base;
+		size_t pos = 0;
+		while(pos < in.size()) {
+			const char32_t cp = in[pos++];
+			if(cp < 0x80) {
+				*dst++ = static_cast<char>(cp);
+			} else {
+				dst = encode_one(cp, dst);
+			}
+		}
+		out.resize(size_t(dst - out.data()));
+	}
+
+	static std::string encode(const std::u32string_view& in) {
+		std::string out;
+		encode(in, out);
+		return out;
+	}
+
+	/**
+	 * @return The number of bytes of the UTF-8 form of @cp, 0 if @cp cannot be encoded.
+	 */
+	static size_t encoded_length(const char32_t cp) {
+		if(cp < 0x80) {
+			return 1;
+		} else if(cp < 0x800) {
+			return 2;
+		} else if(cp < 0x10000) {
+			return (cp >= 0xD800 && cp <= 0xDFFF) ? 0 : 3;
+		} else if(cp <= 0x10FFFF) {
+			return 4;
+		}
+		return 0;
+	}
+
+	/**
+	 * Writes the UTF-8 form of @cp (U+FFFD if @cp cannot be encoded).
+	 * @return The end of the written sequence.
+	 */
+	static char* encode_one(char32_t cp, char* dst) {
+		switch(encoded_length(cp)) {
+			case 1:
+				*dst++ = static_cast<char>(cp);
+				break;
+
+			case 2:
+				*dst++ = static_cast<char>(0xC0 | (cp >> 6));
+				*dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+				break;
+
+			case 4:
+				*dst++ = static_cast<char>(0xF0 | (cp >> 18));
+				*dst++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+				*dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				*dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+				break;
+
+			default:
+				cp = (encoded_length(cp) == 3) ? cp : 0xFFFD;
+				*dst++ = static_cast<char>(0xE0 | (cp >> 12));
+				*dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				*dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+				break;
+		}
+		return dst;
+	}
+
+	/**
+	 * Name of the implementation selected for this CPU.
+	 */
+	static const char* backend() {
+		return impl().name;
+	}
+
+	// -----------------------------------------------------------------
+	// Scalar reference implementation.
+	// -----------------------------------------------------------------
+	static bool is_ascii_scalar(const char* data, size_t size) {
+		uint64_t acc = 0;
+		size_t pos = 0;
+		for(; pos + 8u <= size; pos += 8u) {
+			uint64_t word;
+			memcpy(&word, data + pos, sizeof(word));
+			acc |= word;
+		}
+		for(; pos < size; ++pos) {
+			acc |= static_cast<uint8_t>(data[pos]);
+		}
+		return (acc & 0x8080808080808080ull) == 0;
+	}
+
+	static bool validate_scalar(const uint8_t* src, const size_t size) {
+		size_t pos = 0;
+		bool result = true;
+		while(result && pos < size) {
+			const uint8_t lead = src[pos];
+			if(lead < 0x80) {
+				++pos;
+				continue;
+			}
+			const size_t left = size - pos;
+			if(lead >= 0xC2 && lead <= 0xDF) {
+				result = (left >= 2) && is_cont(src[pos + 1]);
+				pos += 2;
+			} else if(lead >= 0xE0 && lead <= 0xEF) {
+				result = (left >= 3) && is_cont(src[pos + 1]) && is_cont(src[pos + 2]);
+				result = result && not (lead == 0xE0 && src[pos + 1] < 0xA0);
+				result = result && not (lead == 0xED && src[pos + 1] > 0x9F);
+				pos += 3;
+			} else if(lead >= 0xF0 && lead <= 0xF4) {
+				result = (left >= 4) && is_cont(src[pos + 1]) && is_cont(src[pos + 2]) && is_cont(src[pos + 3]);
+				result = result && not (lead == 0xF0 && src[pos + 1] < 0x90);
+				result = result && not (lead == 0xF4 && src[pos + 1] > 0x8F);
+				pos += 4;
+			} else {
+				result = false;
+			}
+		}
+		return result;
+	}
+
+private:
+
+	using IsAscii_t = bool (*)(const char*, size_t);
+	using Validate_t = bool (*)(const uint8_t*, size_t);
+
+	struct Impl {
+		const char* name;
+		IsAscii_t is_ascii;
+		Validate_t validate;
+	};
+
+	static const Impl& impl() {
+		static const Impl selected = select();
+		return selected;
+	}
+
+	static Impl select() {
+#ifdef NIHONGO_UTF8_X86
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) {
+			return Impl{"avx2", &is_ascii_avx2, &validate_avx2};
+		}
+		if(__builtin_cpu_supports("sse2")) {
+			return Impl{"sse2", &is_ascii_sse2, &validate_sse2};
+		}
+#endif
+		return Impl{"scalar", &is_ascii_scalar, &validate_scalar};
+	}
+
+	static bool is_cont(const uint8_t byte) {
+		return (byte & 0xC0) == 0x80;
+	}
+
+	/**
+	 * Decodes a validated sequence.
+	 * @return The number of code points written.
+	 */
+	static size_t decode_valid(const uint8_t* src, const size_t size, char32_t* dst) {
+		char32_t* const begin = dst;
+		size_t pos = 0;
+		while(pos < size) {
+			const uint8_t lead = src[pos];
+			if(lead < 0x80) {
+				size_t run = 1;
+				while(pos + run < size && src[pos + run] < 0x80) {
+					++run;
+				}
+				widen_ascii(src + pos, run, dst);
+				dst += run;
+				pos += run;
+			} else if(lead < 0xE0) {
+				*dst++ = (char32_t(lead & 0x1F) << 6) | (src[pos + 1] & 0x3F);
+				pos += 2;
+			} else if(lead < 0xF0) {
+				*dst++ = (char32_t(lead & 0x0F) << 12) | (char32_t(src[pos + 1] & 0x3F) << 6) | (src[pos + 2] & 0x3F);
+				pos += 3;
+			} else {
+				*dst++ = (char32_t(lead & 0x07) << 18) | (char32_t(src[pos + 1] & 0x3F) << 12)
+					| (char32_t(src[pos + 2] & 0x3F) << 6) | (src[pos + 3] & 0x3F);
+				pos += 4;
+			}
+		}
+		return size_t(dst - begin);
+	}
+
+	static void widen_ascii(const uint8_t* src, const size_t size, char32_t* dst) {
+		size_t pos = 0;
+#ifdef NIHONGO_UTF8_X86
+		const __m128i zero = _mm_setzero_si128();
+		for(; pos + 16u <= size; pos += 16u) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos));
+			const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			auto* out = reinterpret_cast<__m128i*>(dst + pos);
+			_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+		}
+#endif
+		for(; pos < size; ++pos) {
+			dst[pos] = src[pos];
+		}
+	}
+
+#ifdef NIHONGO_UTF8_X86
+
+	// -----------------------------------------------------------------
+	// SSE2.
+	// -----------------------------------------------------------------
+	__attribute__((target("sse2")))
+	static bool is_ascii_sse2(const char* data, const size_t size) {
+		size_t pos = 0;
+		__m128i acc = _mm_setzero_si128();
+		for(; pos + 16u <= size; pos += 16u) {
+			acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos)));
+		}
+		return (_mm_movemask_epi8(acc) == 0) && is_ascii_scalar(data + pos, size - pos);
+	}
+
+	/**
+	 * Skips 16-byte ASCII blocks, validates the rest sequence by sequence.
+	 */
+	__attribute__((target("sse2")))
+	static bool validate_sse2(const uint8_t* src, const size_t size) {
+		size_t pos = 0;
+		bool result = true;
+		while(result && pos < size) {
+			if(pos + 16u <= size) {
+				const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + pos)));
+				if(mask == 0) {
+					pos += 16u;
+					continue;
+				}
+				pos += static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+			} else if(src[pos] < 0x80) {
+				++pos;
+				continue;
+			}
+			const size_t len = sequence_length(src[pos]);
+			result = (len > 1) && (pos + len <= size) && validate_scalar(src + pos, len);
+			pos += len;
+		}
+		return result;
+	}
+
+	static size_t sequence_length(const uint8_t lead) {
+		if(lead < 0x80) {
+			return 1;
+		} else if(lead >= 0xC2 && lead <= 0xDF) {
+			return 2;
+		} else if(lead >= 0xE0 && lead <= 0xEF) {
+			return 3;
+		} else if(lead >= 0xF0 && lead <= 0xF4) {
+			return 4;
+		}
+		return 0;
+	}
+
+	// -----------------------------------------------------------------
+	// AVX2.
+	// -----------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static bool is_ascii_avx2(const char* data, const size_t size) {
+		size_t pos = 0;
+		__m256i acc = _mm256_setzero_si256();
+		for(; pos + 32u <= size; pos += 32u) {
+			acc = _mm256_or_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos)));
+		}
+		return (_mm256_movemask_epi8(acc) == 0) && is_ascii_scalar(data + pos, size - pos);
+	}
+
+	struct Avx2State {
+		__m256i error;
+		__m256i prev_input;
+		__m256i prev_incomplete;
+	};
+
+	__attribute__((target("avx2")))
+	static __m256i prev_bytes(const __m256i input, const __m256i prev_input, const int n) {
+		const __m256i shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+		switch(n) {
+			case 1: return _mm256_alignr_epi8(input, shifted, 16 - 1);
+			case 2: return _mm256_alignr_epi8(input, shifted, 16 - 2);
+			default: return _mm256_alignr_epi8(input, shifted, 16 - 3);
+		}
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i lookup16(const __m256i nibbles, const __m256i table) {
+		return _mm256_shuffle_epi8(table, nibbles);
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i high_nibbles(const __m256i input) {
+		return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+	}
+
+	__attribute__((target("avx2")))
+	static void check_block_avx2(Avx2State& st, const __m256i input) {
+		if(_mm256_movemask_epi8(input) == 0) {
+			// An ASCII block only has to complete the previous one.
+			st.error = _mm256_or_si256(st.error, st.prev_incomplete);
+		} else {
+			constexpr uint8_t TOO_SHORT = 1 << 0;
+			constexpr uint8_t TOO_LONG = 1 << 1;
+			constexpr uint8_t OVERLONG_3 = 1 << 2;
+			constexpr uint8_t TOO_LARGE = 1 << 3;
+			constexpr uint8_t SURROGATE = 1 << 4;
+			constexpr uint8_t OVERLONG_2 = 1 << 5;
+			constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+			constexpr uint8_t OVERLONG_4 = 1 << 6;
+			constexpr uint8_t TWO_CONTS = 1 << 7;
+			constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+			const __m256i byte_1_high_table = _mm256_setr_epi8(
+				TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+				TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+				TOO_SHORT | OVERLONG_2,
+				TOO_SHORT,
+				TOO_SHORT | OVERLONG_3 | SURROGATE,
+				char(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4),
+				TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+				TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+				TOO_SHORT | OVERLONG_2,
+				TOO_SHORT,
+				TOO_SHORT | OVERLONG_3 | SURROGATE,
+				char(TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4));
+
+			const __m256i byte_1_low_table = _mm256_setr_epi8(
+				char(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+				char(CARRY | OVERLONG_2),
+				char(CARRY), char(CARRY),
+				char(CARRY | TOO_LARGE),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4),
+				char(CARRY | OVERLONG_2),
+				char(CARRY), char(CARRY),
+				char(CARRY | TOO_LARGE),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE),
+				char(CARRY | TOO_LARGE | TOO_LARGE_1000), char(CARRY | TOO_LARGE | TOO_LARGE_1000));
+
+			const __m256i byte_2_high_table = _mm256_setr_epi8(
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+				char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+				TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+			const __m256i prev1 = prev_bytes(input, st.prev_input, 1);
+			const __m256i byte_1_high = lookup16(high_nibbles(prev1), byte_1_high_table);
+			const __m256i byte_1_low = lookup16(_mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)), byte_1_low_table);
+			const __m256i byte_2_high = lookup16(high_nibbles(input), byte_2_high_table);
+			const __m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+			// The second and the third continuation bytes are not covered by the tables.
+			const __m256i prev2 = prev_bytes(input, st.prev_input, 2);
+			const __m256i prev3 = prev_bytes(input, st.prev_input, 3);
+			const __m256i is_third_byte = _mm256_subs_epu8(prev2, _mm256_set1_epi8(char(0xE0u - 0x80u)));
+			const __m256i is_fourth_byte = _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xF0u - 0x80u)));
+			const __m256i must23_80 = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8(char(0x80)));
+
+			st.error = _mm256_or_si256(st.error, _mm256_xor_si256(must23_80, special_cases));
+
+			// A lead byte among the last three bytes expects the continuation in the next block.
+			const __m256i max_value = _mm256_setr_epi8(
+				char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF),
+				char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF),
+				char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF),
+				char(0xFF), char(0xFF), char(0xFF), char(0xFF), char(0xFF),
+				char(0xF0u - 1u), char(0xE0u - 1u), char(0xC0u - 1u));
+			st.prev_incomplete = _mm256_subs_epu8(input, max_value);
+		}
+		st.prev_input = input;
+	}
+
+	__attribute__((target("avx2")))
+	static bool validate_avx2(const uint8_t* src, const size_t size) {
+		Avx2State st;
+		st.error = _mm256_setzero_si256();
+		st.prev_input = _mm256_setzero_si256();
+		st.prev_incomplete = _mm256_setzero_si256();
+
+		size_t pos = 0;
+		for(; pos + 32u <= size; pos += 32u) {
+			check_block_avx2(st, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + pos)));
+		}
+		if(pos < size) {
+			// Zero padding is ASCII, a truncated tail sequence is reported as too short.
+			alignas(32) uint8_t tail[32] = {};
+			memcpy(tail, src + pos, size - pos);
+			check_block_avx2(st, _mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+		}
+		st.error = _mm256_or_si256(st.error, st.prev_incomplete);
+		return _mm256_testz_si256(st.error, st.error) != 0;
+	}
+
+#endif
+
+};
@@ -1,24 +1,165 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 using EnumBase_t = int;
 
+/**
+ * The names of the enumerators of @E, tabulated at compile time from the constexpr ToCStr::to_cstr().
+ *
+ * A name is found in an open-addressing table of the name hashes (linear probing, load factor up to 1/2),
+ * so a lookup is O(1) and compares one name in the common case. The order of the names is
+ * precomputed as a rank per enumerator, __SIZE included, by a merge sort.
+ */
+template <typename E, typename ToCStr>
+struct EnumNames {
+
+	static constexpr size_t SIZE = static_cast<size_t>(E::__SIZE);
+
+	/**
+	 * @return The enumerator named @name, __SIZE if there is none.
+	 */
+	static constexpr E find(const std::string_view& name) {
+		const uint32_t hash = hash_of(name);
+		for(size_t pos = hash & MASK;; pos = (pos + 1u) & MASK) {
+			const Slot& slot = TABLE[pos];
+			if(slot.value == SIZE) {
+				return E::__SIZE;
+			}
+			if(slot.hash == hash && name == NAMES[slot.value]) {
+				return static_cast<E>(slot.value);
+			}
+		}
+	}
+
+	/**
+	 * @return The position of the name of @value among the sorted names.
+	 */
+	static constexpr size_t rank(const E value) {
+		const auto idx = static_cast<size_t>(value);
+		return RANKS[idx < SIZE ? idx : SIZE];
+	}
+
+private:
+
+	struct Slot {
+		uint32_t hash;
+		uint32_t value;
+	};
+
+	static constexpr size_t slots() {
+		size_t result = 2;
+		while(result < SIZE * 2u) {
+			result <<= 1u;
+		}
+		return result;
+	}
+
+	static constexpr size_t SLOTS = slots();
+	static constexpr size_t MASK = SLOTS - 1u;
+
+	/**
+	 * 32-bit FNV-1a.
+	 */
+	static constexpr uint32_t hash_of(const std::string_view& str) {
+		uint32_t result = 2166136261u;
+		for(const char ch : str) {
+			result ^= static_cast<unsigned char>(ch);
+			result *= 16777619u;
+		}
+		return result;
+	}
+
+	using Names_t = std::array<std::string_view, SIZE + 1u>;
+	using Ranks_t = std::array<size_t, SIZE + 1u>;
+
+	static constexpr Names_t build_names() {
+		Names_t names = {};
+		for(size_t idx = 0; idx <= SIZE; ++idx) {
+			names[idx] = ToCStr::to_cstr(static_cast<E>(idx));
+		}
+		return names;
+	}
+
+	static constexpr Names_t NAMES = build_names();
+
+	static constexpr std::array<Slot, SLOTS> build_table() {
+		std::array<Slot, SLOTS> table = {};
+		for(auto& slot : table) {
+			slot = Slot{0, static_cast<uint32_t>(SIZE)};
+		}
+		for(size_t idx = 0; idx < SIZE; ++idx) {
+			const uint32_t hash = hash_of(NAMES[idx]);
+			size_t pos = hash & MASK;
+			while(table[pos].value != SIZE) {
+				pos = (pos + 1u) & MASK;
+			}
+			table[pos] = Slot{hash, static_cast<uint32_t>(idx)};
+		}
+		return table;
+	}
+
+	static constexpr Ranks_t build_ranks() {
+		// Bottom-up merge sort of the enumerators by the names, stable.
+		Ranks_t order = {};
+		Ranks_t buf = {};
+		for(size_t idx = 0; idx <= SIZE; ++idx) {
+			order[idx] = idx;
+		}
+		for(size_t width = 1; width <= SIZE; width *= 2u) {
+			for(size_t first = 0; first <= SIZE; first += width * 2u) {
+				const size_t mid = (first + width < SIZE + 1u) ? first + width : SIZE + 1u;
+				const size_t last = (mid + width < SIZE + 1u) ? mid + width : SIZE + 1u;
+				size_t lv = first;
+				size_t rv = mid;
+				for(size_t out = first; out < last; ++out) {
+					buf[out] = (rv >= last || (lv < mid && not (NAMES[order[rv]] < NAMES[order[lv]]))) ? order[lv++] : order[rv++];
+				}
+			}
+			for(size_t idx = 0; idx <= SIZE; ++idx) {
+				order[idx] = buf[idx];
+			}
+		}
+
+		// The equal names share the rank.
+		Ranks_t ranks = {};
+		for(size_t pos = 0; pos <= SIZE; ++pos) {
+			const bool is_tie = pos > 0 && NAMES[order[pos]] == NAMES[order[pos - 1u]];
+			ranks[order[pos]] = is_tie ? ranks[order[pos - 1u]] : pos;
+		}
+		return ranks;
+	}
+
+	static constexpr std::array<Slot, SLOTS> TABLE = build_table();
+	static constexpr Ranks_t RANKS = build_ranks();
+
+};
+
 template <typename E, typename ToCStr, bool PedanticRead = true, typename std::enable_if_t<std::is_enum<E>::value, int> = 0>
 struct EnumField {
 	using Enum_t = E;
+	using Names_t = EnumNames<E, ToCStr>;
 	E value;
 
 	EnumField() : value(E::__SIZE) {}
 
 	EnumField(const E& val) : value(val) {}
 
+	/**
+	 * The fields are ordered by the names.
+	 */
 	bool operator<(const E& val) const {
-		return std::string(to_cstr()) < std::string(ToCStr::to_cstr(val));
+		return Names_t::rank(value) < Names_t::rank(val);
 	}
 
 	bool operator<(const EnumField& val) const {
-		return std::string(to_cstr()) < std::string(val.to_cstr());
+		return Names_t::rank(value) < Names_t::rank(val.value);
 	}
 
 	bool operator!=(const E& val) const {
@@ -37,14 +178,21 @@ struct EnumField {
 		return value;
 	}
 
-	const char* to_cstr() const {
+	constexpr const char* to_cstr() const {
 		return ToCStr::to_cstr(value);
 	}
 
-	static const char* to_cstr(const E& val) {
+	static constexpr const char* to_cstr(const E& val) {
 		return ToCStr::to_cstr(val);
 	}
 
+	/**
+	 * @return The enumerator named @name, __SIZE if there is none.
+	 */
+	static constexpr E from_cstr(const std::string_view& name) {
+		return Names_t::find(name);
+	}
+
 	static constexpr std::string description() {
 		std::string result("Enum : ");
 		const auto SIZE = static_cast<size_t>(E::__SIZE);
@@ -67,4 +215,8 @@ struct EnumField {
 		buf.append(to_cstr());
 	}
 
+	void write(FILE* out) const {
+		fputs(to_cstr(), out);
+	}
+
 };
@@ -0,0 +1,65 @@
+#include "DiceMachine.h"
+#include "DictionarySampler.h"
+#include "DictionaryStore.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/**
+ * The sample is uniform over the valid records, the malformed lines are not candidates
+ * wherever they are : a run of them before the first record, and some between the records.
+ */
+int main() {
+	static constexpr size_t RECORDS = 20;
+	static constexpr size_t K = 5;
+	static constexpr unsigned TRIALS = 40000;
+	// About 7 standard deviations of a frequency around K / RECORDS.
+	static constexpr double TOLERANCE = 0.015;
+
+	std::string text;
+	for(size_t i = 0; i < 12; ++i) {
+		text.append("malformed\n");
+	}
+	for(size_t i = 0; i < RECORDS; ++i) {
+		text.append("k;k;w" + std::to_string(i) + "\n");
+		if(i % 3 == 0) {
+			text.append("malformed\n\xFF;\xFE;bad utf-8\n");
+		}
+	}
+
+	// The malformed lines are reported on every trial.
+	if(freopen("/dev/null", "w", stderr) == nullptr) {
+		return EXIT_FAILURE;
+	}
+
+	size_t hits[RECORDS] = {};
+	bool result = true;
+	for(unsigned trial = 0; result && trial < TRIALS; ++trial) {
+		DiceMachine dm(trial + 1u);
+		DictionarySampler sampler(dm, K);
+		DictionaryStore out;
+		const DictionarySampler::Stat stat = sampler.sample(text, out);
+		result = (stat.candidates == RECORDS) && (out.size() == K);
+		for(size_t idx = 0; result && idx < out.size(); ++idx) {
+			const size_t record = std::stoul(std::string(out[idx].translation.substr(1)));
+			result = (record < RECORDS);
+			hits[record] += result ? 1u : 0u;
+		}
+	}
+	if(not result) {
+		printf("Unexpected candidates or sample size.\n");
+		return EXIT_FAILURE;
+	}
+
+	const double expected = double(K) / double(RECORDS);
+	for(size_t record = 0; record < RECORDS; ++record) {
+		const double freq = double(hits[record]) / double(TRIALS);
+		if(std::fabs(freq - expected) > TOLERANCE) {
+			printf("Record %zu is sampled with the frequency %.4f, %.4f is expected.\n", record, freq, expected);
+			result = false;
+		}
+	}
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}